@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <tonc.h>
+#define LINK_ENABLE_DELTA
+#define LINK_ENABLE_SNAPSHOT
 #include "../../link_connection.h"
 
 LinkConnection conn;
@@ -27,6 +29,7 @@ int main(void) {
     .buffer_len = 30,
     .interval = 50,
     .send_timer_id = 3,
+    .delta_refresh = 30,
   };
   conn = lc_init(settings);
   
@@ -53,12 +56,16 @@ int main(void) {
     u16 message = keys + 1;
     lc_send(&conn, message);
     
-    if (lc_is_connected(&conn)) {
+    // (5) Read the connection state in one piece
+    LinkSnapshot link;
+    lc_snapshot(&conn, &link);
+    
+    if (link.is_connected) {
       
-      sprintf(str, "Players: %d\n", conn.state.player_count);
+      sprintf(str, "Players: %d\n", link.player_count);
       tte_write(str);
       
-      for (int id = 0; id < conn.state.player_count; id++) {
+      for (int id = 0; id < link.player_count; id++) {
         
         while (lc_has_message(&conn, id)) {
           data[id] = lc_read_message(&conn, id) - 1;
@@ -69,7 +76,7 @@ int main(void) {
         
       }
       
-      sprintf(str, "Sent: %d\nSelf pID: %d\n", message, conn.state.current_player_id);
+      sprintf(str, "Sent: %d\nSelf pID: %d\n", message, link.current_player_id);
       tte_write(str);
       
     } else {
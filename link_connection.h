@@ -38,6 +38,9 @@ Usage:
   irq_add(II_SERIAL, mySerialHandler);
   irq_add(II_TIMER3, myTimerHandler);
 
+  (To share a timer with other tasks, pass `.scheduler = &sched` instead, start it with
+  `lc_scheduler_start(&sched)` and call `lc_scheduler_on_timer(&sched)` from its IRQ.)
+
 3) Initialize the library with:
   
   lc_activate(&conn);
@@ -57,6 +60,67 @@ Usage:
 
   lc_destroy(&conn);
 
+Optional features are enabled by defining these before including the header
+(every console in the session must use the same options):
+
+  LINK_ENABLE_RELIABLE: sequence numbers, acks and retransmission for sent
+    messages, so up to `soft_resets` errors in a row are recovered without
+    resetting the connection. Values from 0xFE00 to 0xFFFE are escaped
+    internally (they cost two transfers).
+  LINK_ENABLE_STATS: connection counters, read with `lc_get_stats`.
+  LINK_ENABLE_PING: `lc_ping` measures round-trip times to every player,
+    read with `lc_get_latency`. Uses the same clock as LINK_ENABLE_TRACE.
+  LINK_ENABLE_CRC16: `lc_send_packet` sends a block of words with a CRC16;
+    receivers only deliver it if the CRC matches. The 512-byte table is in ROM,
+    or in IWRAM with LINK_CRC16_TABLE_IWRAM.
+  LINK_ENABLE_BULK: `lc_bulk_send`/`lc_bulk_receive` stream a buffer (even from
+    ROM) in CRC16-checked chunks, with the send timer at a faster pace while a
+    transfer is active. Turns on LINK_ENABLE_CRC16.
+  LINK_ENABLE_LZ77: `lc_lz77_compress` and an incremental decoder for the BIOS
+    LZ77 format, e.g. to shrink blobs before `lc_bulk_send` and decode them
+    from the main loop while they arrive.
+  LINK_ENABLE_BYTES: byte streams, `lc_write`/`lc_read` (or `lc_send_byte`/
+    `lc_read_byte`), packed two bytes per transfer. Turns on
+    LINK_ENABLE_RELIABLE, so a transfer error doesn't lose bytes.
+  LINK_ENABLE_CHANNELS: LINK_CHANNELS (default: 4) independent message streams,
+    `lc_channel_send`/`lc_channel_read`. Channel 0 (`lc_send`) always goes first;
+    the others share what's left by weight (`lc_channel_weight`).
+  LINK_ENABLE_URGENT: `lc_send_urgent` skips the outgoing queue, for the
+    few messages (e.g. pause) that can't wait behind it.
+  LINK_ENABLE_AUTO_BAUD: every console starts at BAUD_RATE_0, and the master
+    moves everyone up (to `baud_rate` at most) while transfers are clean, or
+    down when errors spike. Read the current rate with `lc_baud_rate`.
+  LINK_ENABLE_DELTA: the `delta_refresh` setting (send-on-change) and
+    `lc_held_value`, the last value received from each player.
+  LINK_ENABLE_SNAPSHOT: the IRQ handlers publish the connection state, so
+    `lc_snapshot` can copy it all from the same moment.
+  LINK_ENABLE_TIMEOUT_US: the `timeout_us`/`remote_timeout_us` settings, which
+    detect a dropped link in microseconds instead of frames or transfers.
+    Uses the same clock as LINK_ENABLE_TRACE, so it takes two more timers.
+  LINK_ENABLE_EVENTS: the IRQ handlers report players joining or leaving,
+    resets and role or player id changes, read with `lc_next_event`.
+  LINK_ENABLE_CALLBACKS: `lc_set_callbacks` reports messages and events, from
+    the IRQ handlers or from `lc_dispatch`. Turns on LINK_ENABLE_EVENTS.
+  LINK_ENABLE_CHECKSUM: compares game state checksums between players every
+    few frames (`lc_checksum_start`) and reports the first desynced window.
+  LINK_ENABLE_LOCKSTEP: `LinkLockstep`, frame-tagged inputs with input delay.
+  LINK_ENABLE_ROLLBACK: `LinkRollback`, input history and prediction for
+    rollback netcode. Inputs travel behind an INPUT control word, and go
+    straight from `lc_on_serial` to it. Turns on LINK_ENABLE_LOCKSTEP.
+  LINK_ENABLE_TRACE: a ring of the last LINK_TRACE_LEN IRQ events, read with
+    `lc_trace_dump`. Timestamps come from two cascaded timers starting at
+    LINK_CLOCK_TIMER (default: timers 1 and 2), which stay busy while the
+    link is active. Keep them apart from `send_timer_id` and the scheduler.
+  LINK_ENABLE_RECORD: `lc_record_start` captures every IRQ (with the registers
+    it read) and every call that sends, reads or changes what goes out, so
+    `tools/link_replay` can feed the session back through the library. Uses the
+    same clock. Not available with LINK_ENABLE_BULK.
+
+LINK_LOCK_MODE picks how `lc_` calls keep the IRQ handlers away while they change
+the queues: LINK_LOCK_FLAG (default: the handlers skip that IRQ), LINK_LOCK_IE
+(the serial and send timer IRQs are masked in REG_IE, and run right after) or
+LINK_LOCK_IME (all IRQs are disabled for that long).
+
 */
 
 #include <stdlib.h>
@@ -65,7 +129,14 @@ Usage:
 #include <tonc_memmap.h>
 
 #define LINK_MAX_PLAYERS 4
+#ifndef LINK_CHANNELS
+#define LINK_CHANNELS 4                // With LINK_ENABLE_CHANNELS (2-16)
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+#define LINK_TOTAL_BUFFERS ((LINK_MAX_PLAYERS + 1) * LINK_CHANNELS)
+#else
 #define LINK_TOTAL_BUFFERS (LINK_MAX_PLAYERS + 1)
+#endif
 #define LINK_DISCONNECTED 0xFFFF
 #define LINK_NO_DATA 0x0
 #define LINK_BASE_FREQUENCY TM_FREQ_1024
@@ -82,6 +153,280 @@ Usage:
 #define LINK_SET_HIGH(REG, BIT) REG |= 1 << BIT
 #define LINK_SET_LOW(REG, BIT) REG &= ~(1 << BIT)
 
+#if defined(LINK_ENABLE_BYTES) && !defined(LINK_ENABLE_RELIABLE)
+#define LINK_ENABLE_RELIABLE
+#endif
+#if defined(LINK_ENABLE_BULK) && !defined(LINK_ENABLE_CRC16)
+#define LINK_ENABLE_CRC16
+#endif
+#if defined(LINK_ENABLE_CALLBACKS) && !defined(LINK_ENABLE_EVENTS)
+#define LINK_ENABLE_EVENTS
+#endif
+#if defined(LINK_ENABLE_ROLLBACK) && !defined(LINK_ENABLE_LOCKSTEP)
+#define LINK_ENABLE_LOCKSTEP
+#endif
+#if (defined(LINK_ENABLE_RELIABLE) || defined(LINK_ENABLE_PING) || defined(LINK_ENABLE_CHECKSUM) || \
+     defined(LINK_ENABLE_CRC16) || defined(LINK_ENABLE_BYTES) || defined(LINK_ENABLE_CHANNELS) ||         \
+     defined(LINK_ENABLE_URGENT) || defined(LINK_ENABLE_AUTO_BAUD) || defined(LINK_ENABLE_ROLLBACK)) &&    \
+    !defined(LINK_ENABLE_CONTROL)
+#define LINK_ENABLE_CONTROL
+#endif
+
+// Control words: 0xFE00-0xFEFF are out-of-band (sent before any queued message),
+// 0xFF00-0xFFFE travel inside the message stream. User data in this range is escaped.
+#define LINK_CTRL_BASE 0xFE00
+#define LINK_CTRL_STREAM_BASE 0xFF00
+#define LINK_CTRL(OP, ARG) (LINK_CTRL_BASE | ((OP) << 4) | (ARG))
+#define LINK_CTRL_OP(WORD) (((WORD) >> 4) & 0x1F)
+#define LINK_CTRL_ARG(WORD) ((WORD) & 0xF)
+#define LINK_CTRL_ESCAPE 0xFFFE
+#define LINK_ESCAPE_MASK 0x8000
+#define LINK_OP_SEQ 0
+#define LINK_OP_ACK 1  // + player id
+#define LINK_OP_NAK 5  // + player id
+#define LINK_OP_SYNC 9 // arg: target player id, LINK_SYNC_ALL, or LINK_SYNC_BAUD/LINK_SYNC_SLOWER
+#define LINK_OP_REQ 10 // arg: target player id
+#define LINK_OP_PONG 11 // arg: (pinger id << 2) | ping seq
+#define LINK_OP_CHECK 12 // arg: LINK_CHECK_START | window number, or the next 3 bits of the checksum
+#define LINK_OP_BULK 13  // arg: chunk number & 0xF, followed by the chunk (see "Bulk transfers")
+#define LINK_OP_BULK_REPLY 14 // arg: (sender id << 2) | (nak << 1) | (chunk number & 1)
+#define LINK_OP_CHANNEL_SYNC 15 // arg: channel of the words after the SEQ marker it follows
+#define LINK_OP_PING 16 // in-stream, arg: ping seq
+#define LINK_OP_PACKET 17 // in-stream: a packet starts
+#define LINK_OP_PACKET_END 18 // in-stream: the packet (with its CRC16 as the last two words) ends
+#define LINK_OP_BYTES 19 // in-stream, arg: words - 1, followed by that many byte pairs (see "Byte streams")
+#define LINK_OP_BYTES_ODD 20 // in-stream: same, but the last word only carries one byte
+#define LINK_OP_CHANNEL 21 // in-stream, arg: channel of the next words (see "Channels")
+#define LINK_OP_URGENT 22 // in-stream, followed by an urgent message (see "Urgent messages")
+#define LINK_OP_INPUT 23 // in-stream, followed by a rollback input (see "Rollback input feed")
+#define LINK_SYNC_ALL 0xF
+#define LINK_SYNC_BAUD 8 // + baud rate: the master switches everyone to it (see "Baud rate negotiation")
+#define LINK_SYNC_SLOWER 12 // a slave asks the master for a lower baud rate
+#ifndef LINK_CONTROL_BUFFER_LEN
+#define LINK_CONTROL_BUFFER_LEN 12
+#endif
+// How the main thread keeps the IRQ handlers away from the queues (see `LINK_LOCK`).
+#define LINK_LOCK_FLAG 0               // They see `is_locked` and skip that IRQ
+#define LINK_LOCK_IE 1                 // Serial and timer IRQs are masked in REG_IE, and run right after
+#define LINK_LOCK_IME 2                // All IRQs are disabled with REG_IME, and run right after
+#ifndef LINK_LOCK_MODE
+#define LINK_LOCK_MODE LINK_LOCK_FLAG
+#endif
+#ifndef LINK_URGENT_BUFFER_LEN
+#define LINK_URGENT_BUFFER_LEN 4
+#endif
+#ifndef LINK_BAUD_WINDOW
+#define LINK_BAUD_WINDOW 256           // Transfers per error count (with LINK_ENABLE_AUTO_BAUD)
+#endif
+#ifndef LINK_BAUD_UP_ERRORS
+#define LINK_BAUD_UP_ERRORS 0          // Max. errors in a window for it to count as clean
+#endif
+#ifndef LINK_BAUD_DOWN_ERRORS
+#define LINK_BAUD_DOWN_ERRORS 4        // Errors in a window that step the rate down
+#endif
+#ifndef LINK_BAUD_MAX_BACKOFF
+#define LINK_BAUD_MAX_BACKOFF 6        // A rate that failed N times needs 2^N clean windows to be tried again
+#endif
+#ifndef LINK_BAUD_FALLBACK_ERRORS
+#define LINK_BAUD_FALLBACK_ERRORS 3    // Failed transfers in a row right after a switch that undo it
+#endif
+#define LINK_BAUD_NONE 0xFF
+
+#define LINK_RELIABLE_SEQ_MASK 0xF
+#ifndef LINK_RELIABLE_WINDOW
+#define LINK_RELIABLE_WINDOW 8       // Max. unacknowledged words (must be < 16)
+#endif
+#ifndef LINK_RELIABLE_ACK_EVERY
+#define LINK_RELIABLE_ACK_EVERY 4    // Received words between cumulative acks
+#endif
+#ifndef LINK_RELIABLE_RETRY
+#define LINK_RELIABLE_RETRY 16       // Transfers without progress before retransmitting
+#endif
+#define LINK_RX_FRESH 0   // Needs the sender to restart its stream
+#define LINK_RX_ARMED 1   // Restart announced, waiting for the SEQ marker
+#define LINK_RX_SYNCED 2
+#define LINK_RX_LOST 3    // Waiting for a retransmission
+
+#if (defined(LINK_ENABLE_TRACE) || defined(LINK_ENABLE_RECORD) || defined(LINK_ENABLE_PING) || \
+     defined(LINK_ENABLE_TIMEOUT_US)) &&                                                         \
+    !defined(LINK_ENABLE_CLOCK)
+#define LINK_ENABLE_CLOCK
+#endif
+#ifndef LINK_CLOCK_TIMER
+#define LINK_CLOCK_TIMER 1             // Uses this timer and the next one (cascaded), while active
+#endif
+#define LINK_CLOCK_FREQUENCY 16777216  // Clock ticks per second
+
+#ifndef LINK_TRACE_LEN
+#define LINK_TRACE_LEN 64              // Must be a power of two
+#endif
+#define LINK_EVENT_SERIAL 0
+#define LINK_EVENT_TIMER 1
+#define LINK_EVENT_VBLANK 2
+#define LINK_EVENT_RESET 3
+#define LINK_EVENT_JOINED 4            // Only in the `lc_next_event` queue, not in traces
+#define LINK_EVENT_LEFT 5
+#define LINK_EVENT_ROLE 6
+#define LINK_EVENT_PLAYER_ID 7
+#define LINK_EVENT_BAUD 8              // With LINK_ENABLE_AUTO_BAUD
+#define LINK_RESET_TIMEOUT 0           // No serial IRQ for `timeout` frames (or `timeout_us`)
+#define LINK_RESET_ERROR 1             // More than `soft_resets` consecutive transfer errors
+#ifndef LINK_EVENT_BUFFER_LEN
+#define LINK_EVENT_BUFFER_LEN 8
+#endif
+#define LINK_TRACE_MAGIC 0x5254434C    // "LCTR"
+#define LINK_TRACE_VERSION 1
+
+// Recording format: LinkRecordHeader, then one record per event:
+//   u8 head: bits 0-1 kind (LINK_RECORD_*), then for IRQs: bit 2 = `is_locked` was set,
+//            bit 3 = SIOCNT changed, bits 4-7 = SIOMULTI[n] changed;
+//            for calls: bit 2 = lc_read_message (otherwise lc_send), bit 3 = any other
+//            call, bits 4-5 = player id
+//   varint: clock ticks since the previous record
+//   IRQs: varint cycles spent in the handler, then the changed u16 registers
+//   lc_send: u16 data
+//   other calls: u8 LINK_RECORD_CALL_*, varint a, varint b, then `a` u16 words (packets)
+//                or bytes (writes)
+#define LINK_RECORD_MAGIC 0x5252434C   // "LCRR"
+#define LINK_RECORD_VERSION 4
+#define LINK_RECORD_SERIAL LINK_EVENT_SERIAL
+#define LINK_RECORD_TIMER LINK_EVENT_TIMER
+#define LINK_RECORD_VBLANK LINK_EVENT_VBLANK
+#define LINK_RECORD_CALL 3
+#define LINK_RECORD_MAX_SIZE 24
+#define LINK_RECORD_CALL_URGENT 0         // lc_send_urgent: a = data
+#define LINK_RECORD_CALL_PACKET 1         // lc_send_packet: a = len, then the words
+#define LINK_RECORD_CALL_WRITE 2          // lc_write: a = len, then the bytes
+#define LINK_RECORD_CALL_READ 3           // lc_read: a = len
+#define LINK_RECORD_CALL_CHANNEL_SEND 4   // lc_channel_send: a = channel, b = data
+#define LINK_RECORD_CALL_CHANNEL_READ 5   // lc_channel_read: a = channel
+#define LINK_RECORD_CALL_CHANNEL_WEIGHT 6 // lc_channel_weight: a = channel, b = weight
+#define LINK_RECORD_CALL_CHECKSUM_START 7 // lc_checksum_start: a = every
+#define LINK_RECORD_CALL_CHECKSUM 8       // lc_checksum_submit: a = frame, b = checksum
+#define LINK_RECORD_CALL_PING 9           // lc_ping
+#define LINK_RECORD_CALL_ROLLBACK 10      // lc_rollback_init (a = 1) or lc_rollback_stop (a = 0)
+#define LINK_RECORD_CALL_CALLBACKS 11     // lc_set_callbacks: a = from_irq, b = on_message != NULL
+#define LINK_RECORD_CALL_INPUT 12         // lc_rollback_submit: a = lockstep word
+#define LINK_FEATURE_RELIABLE (1 << 0)
+#define LINK_FEATURE_PING (1 << 1)
+#define LINK_FEATURE_CHECKSUM (1 << 2)
+#define LINK_FEATURE_CRC16 (1 << 3)
+#define LINK_FEATURE_BULK (1 << 4)
+#define LINK_FEATURE_BYTES (1 << 5)
+#define LINK_FEATURE_CHANNELS (1 << 6)
+#define LINK_FEATURE_URGENT (1 << 7)
+#define LINK_FEATURE_TIMEOUT_US (1 << 8)
+#define LINK_FEATURE_AUTO_BAUD (1 << 9)
+#define LINK_FEATURE_ROLLBACK (1 << 10)
+#define LINK_FEATURE_CALLBACKS (1 << 11)
+#define LINK_FEATURE_DELTA (1 << 12)
+
+#define LINK_CRC16_INIT 0xFFFF         // CRC-16/CCITT-FALSE
+#define LINK_CRC16_WORD(BYTE) (0x0100 | (BYTE))
+#define LINK_PACKET_NONE 0
+#define LINK_PACKET_DATA 1
+#define LINK_PACKET_LOST 2             // After a transfer error: discarding words until a packet starts
+
+#ifndef LINK_BYTES_BUFFER_LEN
+#define LINK_BYTES_BUFFER_LEN 64       // Bytes waiting to be sent, and received from each player
+#endif
+#define LINK_BYTES_RUN 16              // Max. words after a BYTES word
+#define LINK_BYTES_NONE 0
+#define LINK_BYTES_DATA 1
+
+#define LINK_CHANNEL_RETAG 16          // Max. words after a CHANNEL word before it's repeated (without LINK_ENABLE_RELIABLE)
+#define LINK_CHANNEL_LOST 0xFF         // After a transfer error: discarding words until the channel is known
+
+#define LINK_URGENT_NONE 0
+#define LINK_URGENT_WORD 1             // The URGENT word
+#define LINK_URGENT_MESSAGE 2          // The message (it leaves the queue after a good transfer)
+#define LINK_URGENT_ESCAPED 1          // URGENT arg: the message is XORed with LINK_ESCAPE_MASK
+
+#define LINK_PING_SEQ_MASK 0b11
+#ifndef LINK_PING_BUCKETS
+#define LINK_PING_BUCKETS 8
+#endif
+#ifndef LINK_PING_BUCKET_TICKS
+#define LINK_PING_BUCKET_TICKS 16384   // Width of the first histogram bucket (~0.98ms)
+#endif
+
+#ifdef LINK_ENABLE_STATS
+#define LINK_STAT_ADD(SELF, FIELD) ((SELF)->stats.FIELD++)
+#define LINK_STAT_MAX(SELF, FIELD, VALUE) \
+  if ((VALUE) > (SELF)->stats.FIELD) (SELF)->stats.FIELD = (VALUE)
+#else
+#define LINK_STAT_ADD(SELF, FIELD)
+#define LINK_STAT_MAX(SELF, FIELD, VALUE)
+#endif
+
+#ifndef LINK_LOCKSTEP_FRAMES
+#define LINK_LOCKSTEP_FRAMES 16        // Local input ring (power of two, > max. input delay)
+#endif
+#define LINK_LOCKSTEP_FLAG 0x8000
+#define LINK_LOCKSTEP_TAG_SHIFT 10
+#define LINK_LOCKSTEP_TAG_MASK 0xF
+#define LINK_LOCKSTEP_INPUT_MASK 0x3FF // Enough for REG_KEYINPUT
+#define LINK_LOCKSTEP_WORD(FRAME, INPUT) \
+  (LINK_LOCKSTEP_FLAG | (((FRAME) & LINK_LOCKSTEP_TAG_MASK) << LINK_LOCKSTEP_TAG_SHIFT) | ((INPUT) & LINK_LOCKSTEP_INPUT_MASK))
+
+#ifndef LINK_ROLLBACK_FRAMES
+#define LINK_ROLLBACK_FRAMES 16        // Input history per player (power of two)
+#endif
+#ifndef LINK_ROLLBACK_MAX_PREDICT
+#define LINK_ROLLBACK_MAX_PREDICT 8    // Max. frames ahead of the last confirmed input (< LINK_ROLLBACK_FRAMES)
+#endif
+#define LINK_ROLLBACK_NONE 0xFFFFFFFF
+
+#define LINK_CHECKSUM_WINDOWS 8        // Windows remembered per player (one per CHECK tag)
+#define LINK_CHECKSUM_NONE 0xFFFFFFFF
+#define LINK_CHECKSUM_WORD(FOLD) ((FOLD) & 0x7FFF)
+#define LINK_CHECKSUM_DIGITS 5         // CHECK words after the first one, 3 bits each
+#define LINK_CHECK_START 0x8
+
+#ifndef LINK_BULK_CHUNK
+#define LINK_BULK_CHUNK 32             // Words per chunk (< 256)
+#endif
+#ifndef LINK_BULK_TIMEOUT
+#define LINK_BULK_TIMEOUT 32           // Transfers to wait for every reply before resending a chunk
+#endif
+#ifndef LINK_BULK_MAX_TRIES
+#define LINK_BULK_MAX_TRIES 16         // Sends of a chunk without a new ack before giving up
+#endif
+#ifndef LINK_BULK_INTERVALS
+#define LINK_BULK_INTERVALS {140, 40, 28, 18} // `interval` while a transfer is active, by baud rate
+#endif
+#define LINK_BULK_WHITEN 0x5A5A        // XORed into data words, so runs of zeros don't need escapes
+#define LINK_BULK_IDLE 0
+#define LINK_BULK_ACTIVE 1
+#define LINK_BULK_DONE 2
+#define LINK_BULK_FAILED 3
+#define LINK_BULK_TX_BEGIN 0
+#define LINK_BULK_TX_LENGTH 1
+#define LINK_BULK_TX_DATA 2
+#define LINK_BULK_TX_CRC_HIGH 3
+#define LINK_BULK_TX_CRC_LOW 4
+#define LINK_BULK_TX_WAIT 5
+#define LINK_BULK_RX_NONE 0
+#define LINK_BULK_RX_LENGTH 1
+#define LINK_BULK_RX_DATA 2
+#define LINK_BULK_RX_CRC_HIGH 3
+#define LINK_BULK_RX_CRC_LOW 4
+#define LINK_BULK_RX_LOST 5            // After a transfer error: discarding words until a chunk starts
+
+#define LINK_LZ77_TYPE 0x10            // First header byte of the BIOS LZ77 format
+#ifndef LINK_LZ77_HASH_BITS
+#define LINK_LZ77_HASH_BITS 8          // Match finder size: 8 bytes of LinkLz77Work per entry
+#endif
+#define LINK_LZ77_NEED_INPUT 0
+#define LINK_LZ77_BUSY 1
+#define LINK_LZ77_DONE 2
+#define LINK_LZ77_ERROR 3
+
+#ifndef LINK_SCHEDULER_SLOTS
+#define LINK_SCHEDULER_SLOTS 4
+#endif
+#define LINK_SCHEDULER_EXTERNAL 0xFF
+
 /**
  * A basic std::queue<u16> replacement.
  */
@@ -91,6 +436,15 @@ typedef struct U16Queue {
   u32 i, j;
 } U16Queue;
 
+/**
+ * The same, for bytes.
+ */
+typedef struct U8Queue {
+  u8 *buf;
+  u32 cap, len;
+  u32 i, j;
+} U8Queue;
+
 typedef enum BaudRate {
   BAUD_RATE_0,  // 9600 bps
   BAUD_RATE_1,  // 38400 bps
@@ -98,6 +452,186 @@ typedef enum BaudRate {
   BAUD_RATE_3   // 115200 bps
 } BaudRate;
 
+typedef void (*LinkTimerCallback)(void *context);
+typedef void (*LinkDesyncCallback)(void *context, u8 player_id, u32 window_start);
+typedef void (*LinkBulkCallback)(void *context, u8 player_id, u32 done, u32 total);
+typedef void (*LinkMessageCallback)(void *context, u8 player_id, u16 message);
+typedef void (*LinkPlayerCallback)(void *context, u8 player_id);
+typedef void (*LinkResetCallback)(void *context, u8 reason);
+
+typedef struct LinkEvent {
+  u8 type;                              // LINK_EVENT_RESET, _JOINED, _LEFT, _ROLE or _PLAYER_ID
+  u8 player_id;                         // JOINED, LEFT: that player. ROLE, PLAYER_ID: this console's new id
+  u8 detail;                            // RESET: LINK_RESET_*. ROLE: true if it's the master now
+  u32 frame;                            // `lc_frame` when it happened
+} LinkEvent;
+
+typedef void (*LinkEventCallback)(void *context, const LinkEvent *event);
+
+typedef struct LinkSnapshot {
+  u32 frame;                            // `lc_frame` when it was taken
+  u8 player_count;
+  u8 current_player_id;
+  u8 connected;                         // Bitmask of the connected players (this console included)
+  bool is_master;
+  bool is_connected;                    // Same as `lc_is_connected`
+} LinkSnapshot;
+
+typedef struct LinkCallbacks {
+  LinkMessageCallback on_message;       // Takes the message out of the incoming queue
+  LinkPlayerCallback on_connected;
+  LinkPlayerCallback on_disconnected;
+  LinkResetCallback on_reset;           // The connection was reset (every player left)
+  LinkEventCallback on_event;           // Every event, before the specific callback
+  void *context;
+  bool from_irq;                        // Call them from `lc_on_serial`/`lc_on_timer` instead of `lc_dispatch`
+} LinkCallbacks;
+
+typedef struct LinkTimerSlot {
+  LinkTimerCallback callback;
+  void *context;
+  u32 period;
+  u32 remaining;
+} LinkTimerSlot;
+
+/**
+ * A software timer wheel driven by one hardware timer, so the link
+ * (and anything else) can run periodic tasks without owning a timer.
+ */
+typedef struct LinkScheduler {
+  LinkTimerSlot slots[LINK_SCHEDULER_SLOTS];
+  u8 timer_id;   // LINK_SCHEDULER_EXTERNAL if `lc_scheduler_on_timer` is called from another periodic IRQ
+  u16 tick;      // Number of 1024-cycles (61.04μs) ticks between calls to `lc_scheduler_on_timer`
+} LinkScheduler;
+
+/**
+ * Connection counters (see `lc_get_stats`). They're only updated with LINK_ENABLE_STATS.
+ */
+typedef struct LinkStats {
+  u32 transfers;                                // Serial IRQs without errors
+  u32 transfer_errors;                          // Serial IRQs with LINK_BIT_ERROR or without LINK_BIT_READY
+  u32 words_sent;                               // Messages and control words sent by this console
+  u32 words_received[LINK_MAX_PLAYERS];         // Words received from each player
+  u32 send_rejects;                             // `lc_send` calls with reserved values
+  u32 queue_overflows;                          // Messages dropped or rejected because a queue was full
+  u32 retransmissions;                          // Times the outgoing stream was resent (LINK_ENABLE_RELIABLE)
+  u32 resets_timeout;                           // Resets by `lc_on_timer` (no serial IRQ for `timeout` frames)
+  u32 resets_error;                             // Resets by transfer errors
+  u32 resets_soft;                              // Soft resets by transfer errors (see `soft_resets`)
+  u32 locked_skips;                             // IRQs ignored because the main thread held the queues
+  u32 sends_suppressed;                         // `lc_send` calls skipped by send-on-change (see `delta_refresh`)
+  u32 incoming_high_water[LINK_MAX_PLAYERS];
+  u32 outgoing_high_water;
+} LinkStats;
+
+/**
+ * Round-trip times to one player, in clock ticks (LINK_CLOCK_FREQUENCY per second).
+ * See `lc_ping` and `lc_get_latency`.
+ */
+typedef struct LinkLatency {
+  u32 count;                            // Pongs received
+  u32 lost;                             // Pings the player didn't answer before the next one
+  u32 last;
+  u32 min;
+  u32 max;
+  u32 average;                          // Moving average (each new sample weighs 1/8)
+  u16 histogram[LINK_PING_BUCKETS];     // Bucket n: < LINK_PING_BUCKET_TICKS << n (the last one: the rest)
+} LinkLatency;
+
+/**
+ * An IRQ recorded by LINK_ENABLE_TRACE.
+ */
+typedef struct LinkTraceEvent {
+  u32 time;                             // `lc_clock_now()` when the IRQ started
+  u16 siocnt;
+  u16 data[LINK_MAX_PLAYERS];           // REG_SIOMULTI
+  u8 type;                              // LINK_EVENT_*
+  u8 outgoing_len;
+  u8 incoming_len[LINK_MAX_PLAYERS];
+} LinkTraceEvent;
+
+/**
+ * Header written by `lc_trace_save`, followed by `count` LinkTraceEvent records.
+ */
+typedef struct LinkTraceHeader {
+  u32 magic;                            // LINK_TRACE_MAGIC
+  u16 version;                          // LINK_TRACE_VERSION
+  u16 event_size;                       // sizeof(LinkTraceEvent)
+  u32 frequency;                        // Clock ticks per second
+  u32 count;
+} LinkTraceHeader;
+
+/**
+ * Header written by `lc_record_start`, with the settings needed to replay the session.
+ */
+typedef struct LinkRecordHeader {
+  u32 magic;                            // LINK_RECORD_MAGIC
+  u16 version;                          // LINK_RECORD_VERSION
+  u16 features;                         // LINK_FEATURE_* options of the recording build
+  u32 frequency;                        // Clock ticks per second
+  u32 length;                           // Bytes of records after the header (set by `lc_record_stop`)
+  u8 baud_rate;
+  u8 send_timer_id;
+  u16 reserved;
+  u32 timeout;
+  u32 remote_timeout;
+  u32 soft_resets;
+  u32 buffer_len;
+  u32 interval;
+  u32 delta_refresh;
+  u32 timeout_us;
+  u32 remote_timeout_us;
+} LinkRecordHeader;
+
+/**
+ * A blob being sent with `lc_bulk_send`, or received from one player with `lc_bulk_receive`.
+ */
+typedef struct LinkBulk {
+  const u8 *src;                        // Blob being sent
+  u8 *dst;                              // Buffer being received into
+  u32 cap;                              // Size of `dst`
+  volatile u32 len;                     // Blob size in bytes (received: known after chunk 0)
+  volatile u32 chunk;                   // Next chunk to send or to store (0 = the length)
+  volatile u8 status;                   // LINK_BULK_*
+  u8 phase;                             // LINK_BULK_TX_* or LINK_BULK_RX_*
+  bool escaped;                         // Receiver: the next word was escaped
+  bool nakked;                          // Sender: a NAK arrived while the chunk was going out;
+                                        // receiver: the chunk was already rejected
+  bool seen;                            // Receiver: the player has sent chunks
+  u8 tries;                             // Sends of the current chunk since a player last acknowledged it
+  u8 waiting;                           // Bitmask of players that haven't acknowledged the chunk
+  u8 count;                             // Words in the current chunk
+  u8 pos;
+  u16 pending;                          // Escaped word to send next (0 = none)
+  u16 crc;
+  u16 length[2];                        // Chunk 0, until its CRC is checked
+  u32 current;                          // Chunk being received
+  u32 wait;                             // Transfers since the chunk was sent
+  u32 reported;                         // Bytes last passed to the progress callback
+} LinkBulk;
+
+/**
+ * Match finder of `lc_lz77_compress`: the last two positions with each hash (runs need
+ * the older one, since distance 1 isn't used). Too big for the IWRAM stack.
+ */
+typedef struct LinkLz77Work {
+  u32 heads[1 << LINK_LZ77_HASH_BITS][2];
+} LinkLz77Work;
+
+/**
+ * Incremental decoder for the BIOS LZ77 format. See `lc_lz77_decode`.
+ */
+typedef struct LinkLz77Decoder {
+  u8 *dst;
+  u32 cap;
+  u32 len;                              // Decompressed size (once the header arrived)
+  u32 in;                               // Compressed bytes consumed
+  u32 out;                              // Bytes written to `dst`
+  u8 flags;                             // Block flags, next one in bit 7
+  u8 bits;                              // Flags left in the block
+  u8 status;                            // LINK_LZ77_*
+} LinkLz77Decoder;
+
 typedef struct LinkState {
   u8 player_count;
   u8 current_player_id;
@@ -108,7 +642,64 @@ typedef struct LinkState {
   int timeouts[LINK_MAX_PLAYERS];
   bool irq_flag;
   u32 irq_timeout;
+  u32 failures;
   volatile bool is_locked;
+  u16 irq_mask;                         // REG_IE bits of the serial and send timer IRQs (for LINK_LOCK_IE)
+#ifdef LINK_ENABLE_TIMEOUT_US
+  u32 irq_time;                         // `lc_clock_now()` at the last good transfer
+  u32 seen_time[LINK_MAX_PLAYERS];      // ... and at the last word from each player
+#endif
+#ifdef LINK_ENABLE_CONTROL
+  U16Queue control_messages;
+  u16 control_buffer[LINK_CONTROL_BUFFER_LEN];
+  bool rx_escaped[LINK_MAX_PLAYERS];
+#endif
+#ifdef LINK_ENABLE_CRC16
+  u8 rx_packet[LINK_MAX_PLAYERS];       // LINK_PACKET_*
+  u16 rx_crc[LINK_MAX_PLAYERS];         // CRC of the packet words except the last two
+  u16 rx_tail[LINK_MAX_PLAYERS][2];     // The last two words (the CRC, once PACKET_END arrives)
+  u32 rx_hidden[LINK_MAX_PLAYERS];      // Words at the back of `incoming_messages` waiting for their CRC (or discarded)
+#endif
+#ifdef LINK_ENABLE_BYTES
+  U8Queue tx_bytes;                     // Bytes not moved to `outgoing_messages` yet
+  U8Queue rx_bytes[LINK_MAX_PLAYERS];
+  u8 tx_bytes_buffer[LINK_BYTES_BUFFER_LEN];
+  u8 rx_bytes_buffer[LINK_MAX_PLAYERS][LINK_BYTES_BUFFER_LEN];
+  u8 rx_run[LINK_MAX_PLAYERS];          // LINK_BYTES_*
+  u8 rx_run_left[LINK_MAX_PLAYERS];     // Words left in the run (or to discard, when lost)
+  bool rx_run_odd[LINK_MAX_PLAYERS];
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+  U16Queue channel_out[LINK_CHANNELS - 1];                     // Channels 1+ (channel 0 is `outgoing_messages`)
+  U16Queue channel_in[LINK_CHANNELS - 1][LINK_MAX_PLAYERS];
+  u8 tx_channel;                        // Channel of the last word in `outgoing_messages`
+  u8 tx_tagged;                         // Words since its CHANNEL word
+  u8 tx_head_channel;                   // Channel of the first word in `outgoing_messages`
+  u8 rx_channel[LINK_MAX_PLAYERS];      // Channel of each player's next word, or LINK_CHANNEL_LOST
+  u8 rx_channel_lost[LINK_MAX_PLAYERS]; // Words discarded since the channel was lost
+#endif
+#ifdef LINK_ENABLE_URGENT
+  U16Queue urgent_messages;
+  u16 urgent_buffer[LINK_URGENT_BUFFER_LEN];
+  u8 tx_urgent;                         // LINK_URGENT_*: last word sent of the front message
+  bool rx_urgent[LINK_MAX_PLAYERS];     // The next word is an urgent message
+  bool rx_urgent_escaped[LINK_MAX_PLAYERS];
+#endif
+#ifdef LINK_ENABLE_ROLLBACK
+  bool rx_input[LINK_MAX_PLAYERS];      // The next word is a rollback input
+#endif
+#ifdef LINK_ENABLE_RELIABLE
+  u32 tx_sent;                       // Words after the queue head that were already transmitted
+  u32 tx_stall;
+  u8 tx_seq;                         // Sequence number of the queue head
+  bool tx_marker;
+  u8 tx_acked[LINK_MAX_PLAYERS];     // Next sequence number expected by each player
+  u8 rx_seq[LINK_MAX_PLAYERS];       // Next sequence number expected from each player
+  u8 rx_pos[LINK_MAX_PLAYERS];       // Sequence number of the next incoming word
+  u8 rx_sync[LINK_MAX_PLAYERS];
+  u8 rx_unacked[LINK_MAX_PLAYERS];
+  u8 ack_pending;
+#endif
 } LinkState;
 
 /**
@@ -121,23 +712,175 @@ typedef struct LinkConnection {
   BaudRate baud_rate;
   u32 timeout;
   u32 remote_timeout;
+  u32 soft_resets;
   u32 buffer_len;
   u16 *buffer_mem;   // This remains NULL if the struct was initialised with `lc_init_manual`.
   u32 interval;
   u8 send_timer_id;
+  LinkScheduler *scheduler;
+  int timer_slot;
+  volatile u32 frame;                   // VBlanks since `lc_activate`
   volatile bool is_enabled;
+#ifdef LINK_ENABLE_DELTA
+  u32 delta_refresh;
+  u16 delta_last;                       // Last value queued by `lc_send` (LINK_NO_DATA after a reset)
+  u32 delta_skips;                      // `lc_send` calls it was skipped since
+  u16 held[LINK_MAX_PLAYERS];           // Last message received from each player
+  u32 held_since[LINK_MAX_PLAYERS];     // `frame` when it changed
+#endif
+#ifdef LINK_ENABLE_SNAPSHOT
+  volatile LinkSnapshot snapshot;       // Published by the IRQ handlers for `lc_snapshot`
+  volatile u32 snapshot_seq;            // Odd while `snapshot` is being written
+#endif
+#ifdef LINK_ENABLE_AUTO_BAUD
+  BaudRate baud_max;                    // `baud_rate` setting
+  u8 baud_next;                         // Rate announced by the master, not applied yet (LINK_BAUD_NONE)
+  bool baud_switch;                     // The announcement is in this transfer: switch at its end
+  u8 baud_previous;                     // Rate before the switch, until a transfer works (LINK_BAUD_NONE)
+  u8 baud_strikes[4];                   // Times each rate was stepped down from
+  u8 baud_clean;                        // Clean windows in a row at this rate
+  bool baud_slower;                     // A slave asked for a lower rate
+  u16 baud_transfers;                   // In the current window
+  u16 baud_errors;
+  u32 baud_crc_errors;                  // CRC failures already counted
+#endif
+#ifdef LINK_ENABLE_TIMEOUT_US
+  u32 timeout_us;
+  u32 remote_timeout_us;
+  u32 timeout_ticks;                    // `timeout_us` and `remote_timeout_us` in clock ticks (0 = off)
+  u32 remote_timeout_ticks;
+#endif
+#ifdef LINK_ENABLE_STATS
+  LinkStats stats;
+#endif
+#ifdef LINK_ENABLE_ROLLBACK
+  struct LinkRollback *rollback;
+#endif
+#ifdef LINK_ENABLE_CRC16
+  u32 packets_received;                 // Packets delivered with a valid CRC
+  u32 packets_dropped;                  // Packets dropped for a bad CRC or missing words
+#endif
+#ifdef LINK_ENABLE_BYTES
+  u32 bytes_dropped;                    // Received bytes that didn't fit in `rx_bytes`
+#endif
+#ifdef LINK_ENABLE_EVENTS
+  LinkEvent events[LINK_EVENT_BUFFER_LEN];
+  u8 event_next;                        // Oldest event
+  u8 event_count;
+  u8 event_role;                        // Last reported role and player id (0xFF = none since the reset)
+  u8 event_player_id;
+  u32 events_dropped;                   // Oldest events overwritten because the queue was full
+#endif
+#ifdef LINK_ENABLE_CALLBACKS
+  LinkCallbacks callbacks;
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+  u8 channel_weight[LINK_CHANNELS];     // 0 = strict priority
+  s16 channel_credit[LINK_CHANNELS];
+#endif
+#ifdef LINK_ENABLE_BULK
+  LinkBulk bulk_tx;
+  LinkBulk bulk_rx[LINK_MAX_PLAYERS];
+  u32 bulk_interval;                    // `interval` to restore when no transfer is active
+  bool bulk_fast;
+  u32 bulk_resent;                      // Chunks sent again after a NAK or a timeout
+  u32 bulk_nakked;                      // Chunks this console rejected (bad CRC or missing words)
+#endif
+#ifdef LINK_ENABLE_CHECKSUM
+  u32 check_every;                      // Frames per checksum window (0 = off)
+  LinkDesyncCallback on_desync;
+  void *desync_context;
+  u16 check_fold;
+  u32 check_window;                     // Window being folded by `lc_checksum_submit`
+  u16 check_local[LINK_CHECKSUM_WINDOWS];
+  u16 check_remote[LINK_MAX_PLAYERS][LINK_CHECKSUM_WINDOWS];
+  u32 check_remote_window[LINK_MAX_PLAYERS][LINK_CHECKSUM_WINDOWS];  // Window number + 1 (0 = empty)
+  s8 check_tag[LINK_MAX_PLAYERS];       // Window tag of the checksum being received, or -1
+  u16 check_value[LINK_MAX_PLAYERS];    // Its bits received so far
+  u8 check_digits[LINK_MAX_PLAYERS];
+  volatile u32 desync_window_start[LINK_MAX_PLAYERS];  // First frame of the earliest window that didn't match
+  bool desync_reported[LINK_MAX_PLAYERS];
+  u32 checks;                           // Windows compared with a player
+  u32 check_skips;                      // Windows not sent because the control queue was full
+#endif
+#ifdef LINK_ENABLE_PING
+  LinkLatency latency[LINK_MAX_PLAYERS];
+  u32 ping_time;
+  u8 ping_seq;
+  u8 ping_waiting;   // Bitmask of players that haven't answered the last ping
+#endif
+#ifdef LINK_ENABLE_TRACE
+  LinkTraceEvent trace[LINK_TRACE_LEN];
+  u32 trace_next;
+  volatile bool trace_paused;
+#endif
+#ifdef LINK_ENABLE_RECORD
+  vu8 *record_buf;
+  u32 record_cap;
+  u32 record_len;
+  u32 record_time;
+  u16 record_siocnt;
+  u16 record_data[LINK_MAX_PLAYERS];
+  volatile bool is_recording;
+#endif
 } LinkConnection;
 
+/**
+ * Frame lockstep on top of a connection: every player submits one input per frame,
+ * and frame N runs once everyone's input for N arrived. See `lc_lockstep_init`.
+ */
+typedef struct LinkLockstep {
+  LinkConnection *conn;
+  u32 frame;                            // Next frame returned by `lc_lockstep_inputs`
+  u32 submitted;                        // Frame tagged by the next `lc_lockstep_submit`
+  u8 delay;                             // Frames of input delay
+  u16 local[LINK_LOCKSTEP_FRAMES];
+  u16 last[LINK_MAX_PLAYERS];           // Last input from each player (repeated if one is lost)
+  u32 stalls;                           // `lc_lockstep_ready` calls that had to wait
+  u32 current_stall;
+  u32 longest_stall;                    // Most consecutive waits
+  u32 dropped;                          // Stale or foreign words discarded from the queues
+  u32 lost;                             // Inputs lost in transit (the previous one is repeated)
+} LinkLockstep;
+
+typedef void (*LinkRollbackCallback)(void *context, u32 frame, u32 count);
+
+/**
+ * Rollback on top of a connection: the game runs ahead with predicted inputs and
+ * resimulates when a real input differs. See `lc_rollback_init`.
+ */
+typedef struct LinkRollback {
+  LinkConnection *conn;
+  u16 inputs[LINK_MAX_PLAYERS][LINK_ROLLBACK_FRAMES]; // By frame: confirmed, or the prediction the game used
+  volatile u32 confirmed[LINK_MAX_PLAYERS];           // Inputs before this frame are real (written by `lc_on_serial`)
+  volatile u32 rollback_from;                         // First mispredicted frame, or LINK_ROLLBACK_NONE
+  u32 fetched;                                        // Frames before this one were handed to the game
+  u32 frame;                                          // Current frame
+  LinkRollbackCallback on_rollback;
+  void *context;
+  u32 rollbacks;
+  u32 resimulated;                      // Total frames resimulated
+  u32 longest_rollback;
+  u32 stalls;                           // `lc_rollback_ready` calls that had to wait
+  u32 dropped;                          // Stale or foreign words discarded
+  u32 lost;                             // Inputs lost in transit (the previous one is repeated)
+} LinkRollback;
+
 /**
  * Parameters for `lc_init`
  */
 typedef struct LinkConnectionSettings {
-  BaudRate baud_rate;    // Sets a specific baud rate.
+  BaudRate baud_rate;    // Sets a specific baud rate (the highest one to try, with LINK_ENABLE_AUTO_BAUD).
   u32 timeout;           // Number of frames without an II_SERIAL IRQ to reset the connection.
   u32 remote_timeout;    // Number of messages with 0xFFFF to mark a player as disconnected.
+  u32 soft_resets;       // Number of consecutive SIO errors recovered without clearing the queues (0 = always reset, even with LINK_ENABLE_RELIABLE).
   u32 buffer_len;        // Number of messages that the queues will be able to store.
   u32 interval;          // Number of 1024-cycles (61.04μs) ticks between messages (50 = 3,052ms). It's the interval of the timer chosen by `send_timer_id`.
   u8 send_timer_id;      // GBA Timer to use for sending.
+  LinkScheduler *scheduler; // Shared timer to use instead of `send_timer_id` (optional). `interval` is rounded to its tick.
+  u32 delta_refresh;     // With LINK_ENABLE_DELTA: send-on-change, `lc_send` skips values equal to the last one, but sends them once every N calls anyway (0 = off).
+  u32 timeout_us;        // With LINK_ENABLE_TIMEOUT_US: microseconds without a good transfer to reset the connection, checked on every timer IRQ (0 = only `timeout`).
+  u32 remote_timeout_us; // With LINK_ENABLE_TIMEOUT_US: microseconds of 0xFFFF from a player to mark it as disconnected (0 = only `remote_timeout`).
 } LinkConnectionSettings;
 
 
@@ -155,7 +898,7 @@ inline static U16Queue u16q_init(u32 cap, u16 *buf) {
 }
 
 inline static bool u16q_empty(U16Queue *q) {
-  return q->i == q->j;
+  return q->len == 0;
 }
 
 inline static u16 u16q_front(U16Queue *q) {
@@ -178,6 +921,26 @@ inline static void u16q_push(U16Queue *q, u16 n) {
   q->len++;
 }
 
+inline static void u16q_drop_back(U16Queue *q, u32 count) {
+  if (count > q->len) {
+    count = q->len;
+  }
+  q->j = q->j >= count ? q->j - count : q->j + q->cap - count;
+  q->len -= count;
+}
+
+// Moves the last word `count` places towards the front.
+inline static void u16q_sink(U16Queue *q, u32 count) {
+  u32 k = q->j == 0 ? q->cap - 1 : q->j - 1;
+  for (u32 n = 0; n < count && n + 1 < q->len; n++) {
+    u32 previous = k == 0 ? q->cap - 1 : k - 1;
+    u16 value = q->buf[k];
+    q->buf[k] = q->buf[previous];
+    q->buf[previous] = value;
+    k = previous;
+  }
+}
+
 static inline u16 LINK_QUEUE_POP(U16Queue *q) {
   if (u16q_empty(q)) {
     return LINK_NO_DATA;
@@ -193,8 +956,470 @@ static inline void LINK_QUEUE_CLEAR(U16Queue *q) {
   }
 }
 
+inline static U8Queue u8q_init(u32 cap, u8 *buf) {
+  return (U8Queue) {
+    .buf = buf,
+    .cap = cap,
+    .len = 0,
+    .i = 0,
+    .j = 0,
+  };
+}
+
+// The `n`th byte from the front.
+inline static u8 u8q_at(U8Queue *q, u32 n) {
+  n += q->i;
+  return q->buf[n >= q->cap ? n - q->cap : n];
+}
+
+inline static u8 u8q_pop(U8Queue *q) {
+  u8 value = q->buf[q->i++];
+  if (q->i >= q->cap) {
+    q->i = 0;
+  }
+  q->len--;
+  return value;
+}
+
+inline static void u8q_push(U8Queue *q, u8 n) {
+  q->buf[q->j++] = n;
+  if (q->j >= q->cap) {
+    q->j = 0;
+  }
+  q->len++;
+}
+
+// Copies as many of `len` bytes as fit to the back, in two pieces at most (byte
+// accesses only: `src` may be in SRAM). Returns the number of bytes copied.
+inline static u32 u8q_write(U8Queue *q, const u8 *src, u32 len) {
+  if (len > q->cap - q->len) {
+    len = q->cap - q->len;
+  }
+  for (u32 done = 0; done < len;) {
+    u32 piece = q->cap - q->j < len - done ? q->cap - q->j : len - done;
+    for (u32 n = 0; n < piece; n++) {
+      q->buf[q->j + n] = src[done + n];
+    }
+    q->j += piece;
+    if (q->j >= q->cap) {
+      q->j = 0;
+    }
+    done += piece;
+  }
+  q->len += len;
+  return len;
+}
+
+// Moves up to `len` bytes from the front to `dst`, in two pieces at most.
+inline static u32 u8q_read(U8Queue *q, u8 *dst, u32 len) {
+  if (len > q->len) {
+    len = q->len;
+  }
+  for (u32 done = 0; done < len;) {
+    u32 piece = q->cap - q->i < len - done ? q->cap - q->i : len - done;
+    for (u32 n = 0; n < piece; n++) {
+      dst[done + n] = q->buf[q->i + n];
+    }
+    q->i += piece;
+    if (q->i >= q->cap) {
+      q->i = 0;
+    }
+    done += piece;
+  }
+  q->len -= len;
+  return len;
+}
+
+// Shared timer scheduler
+// ----------------------
+
+/**
+ * Create a scheduler. `tick` is the period of `lc_scheduler_on_timer` calls, in 1024-cycles ticks.
+ */
+static inline LinkScheduler lc_scheduler_init(u8 timer_id, u16 tick) {
+  LinkScheduler self = {
+    .timer_id = timer_id,
+    .tick = tick > 0 ? tick : 1,
+  };
+  return self;
+}
+
+/**
+ * Start the hardware timer (does nothing for LINK_SCHEDULER_EXTERNAL).
+ */
+static inline void lc_scheduler_start(LinkScheduler *self) {
+  if (self->timer_id == LINK_SCHEDULER_EXTERNAL) {
+    return;
+  }
+  REG_TM[self->timer_id].start = -(self->tick);
+  REG_TM[self->timer_id].cnt = TM_ENABLE | TM_IRQ | LINK_BASE_FREQUENCY;
+}
+
+static inline void lc_scheduler_stop(LinkScheduler *self) {
+  if (self->timer_id == LINK_SCHEDULER_EXTERNAL) {
+    return;
+  }
+  REG_TM[self->timer_id].cnt = REG_TM[self->timer_id].cnt & (~TM_ENABLE);
+}
+
+/**
+ * Register a periodic callback, `interval` in 1024-cycles ticks (rounded to the nearest scheduler tick).
+ * Returns the slot, or -1 if there's no free one.
+ */
+static inline int lc_scheduler_add(LinkScheduler *self, u32 interval, LinkTimerCallback callback, void *context) {
+  u32 period = (interval + self->tick / 2) / self->tick;
+  if (period == 0) {
+    period = 1;
+  }
+  for (int i = 0; i < LINK_SCHEDULER_SLOTS; i++) {
+    LinkTimerSlot *slot = &self->slots[i];
+    if (slot->callback == NULL) {
+      slot->context = context;
+      slot->period = period;
+      slot->remaining = period;
+      slot->callback = callback;
+      return i;
+    }
+  }
+  return -1;
+}
+
+static inline void lc_scheduler_remove(LinkScheduler *self, int slot) {
+  if (slot >= 0 && slot < LINK_SCHEDULER_SLOTS) {
+    self->slots[slot].callback = NULL;
+  }
+}
+
+/**
+ * Call this from the scheduler's timer IRQ.
+ */
+static inline void lc_scheduler_on_timer(LinkScheduler *self) {
+  for (int i = 0; i < LINK_SCHEDULER_SLOTS; i++) {
+    LinkTimerSlot *slot = &self->slots[i];
+    if (slot->callback != NULL && --slot->remaining == 0) {
+      slot->remaining = slot->period;
+      slot->callback(slot->context);
+    }
+  }
+}
+
+
+// Free-running clock
+// ------------------
+
+#ifdef LINK_ENABLE_CLOCK
+static inline void lc_clock_start(void) {
+  REG_TM[LINK_CLOCK_TIMER].cnt = 0;
+  REG_TM[LINK_CLOCK_TIMER + 1].cnt = 0;
+  REG_TM[LINK_CLOCK_TIMER].start = 0;
+  REG_TM[LINK_CLOCK_TIMER + 1].start = 0;
+  REG_TM[LINK_CLOCK_TIMER + 1].cnt = TM_ENABLE | TM_CASCADE;
+  REG_TM[LINK_CLOCK_TIMER].cnt = TM_ENABLE | TM_FREQ_SYS;
+}
+
+static inline void lc_clock_stop(void) {
+  REG_TM[LINK_CLOCK_TIMER].cnt = 0;
+  REG_TM[LINK_CLOCK_TIMER + 1].cnt = 0;
+}
+
+/**
+ * Cycles since `lc_activate` (wraps every ~256 seconds).
+ */
+static inline u32 lc_clock_now(void) {
+  u16 high = REG_TM[LINK_CLOCK_TIMER + 1].count;
+  u16 low = REG_TM[LINK_CLOCK_TIMER].count;
+  u16 high_after = REG_TM[LINK_CLOCK_TIMER + 1].count;
+  if (high != high_after) {
+    // The low half overflowed between the reads.
+    low = REG_TM[LINK_CLOCK_TIMER].count;
+  }
+  return ((u32)high_after << 16) | low;
+}
+
+// Microseconds to clock ticks, without 64-bit math (16777 ticks per ms, ~0.001% short).
+static inline u32 lc_clock_ticks(u32 us) {
+  return us / 1000 * 16777 + us % 1000 * 16777 / 1000;
+}
+#endif
+
+
+// CRC16
+// -----
+
+#ifdef LINK_ENABLE_CRC16
+#ifdef LINK_CRC16_TABLE_IWRAM
+#define LINK_CRC16_TABLE_ATTR IWRAM_DATA
+#else
+#define LINK_CRC16_TABLE_ATTR const
+#endif
+
+static LINK_CRC16_TABLE_ATTR u16 lc_crc16_table[256] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+  0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+  0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+  0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+  0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+  0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+  0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+  0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+  0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+  0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+  0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+  0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+  0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+  0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+  0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+  0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+  0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+  0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+  0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+  0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+  0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+  0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+  0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+  0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+  0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+  0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+  0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+  0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+  0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+  0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+  0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+/**
+ * Add one word (low byte first) to a running CRC16 started at LINK_CRC16_INIT.
+ */
+static inline u16 lc_crc16_update(u16 crc, u16 word) {
+  crc = (crc << 8) ^ lc_crc16_table[(crc >> 8) ^ (word & 0xFF)];
+  crc = (crc << 8) ^ lc_crc16_table[(crc >> 8) ^ (word >> 8)];
+  return crc;
+}
+
+static inline u16 lc_crc16(const u16 *data, u32 len) {
+  u16 crc = LINK_CRC16_INIT;
+  for (u32 i = 0; i < len; i++) {
+    crc = lc_crc16_update(crc, data[i]);
+  }
+  return crc;
+}
+#endif
+
+
+// LZ77 (BIOS format)
+// ------------------
+// A 4-byte header (LINK_LZ77_TYPE | size << 8), then blocks of a flag byte and 8 items,
+// MSB first: a literal byte (0), or a 2-byte back-reference (1) of 3-18 bytes at a
+// distance of 1-4096. The compressor never uses distance 1, so the BIOS VRAM decoder
+// can take its output too.
+
+#ifdef LINK_ENABLE_LZ77
+static inline u32 lc_lz77_hash(const u8 *p) {
+  return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - LINK_LZ77_HASH_BITS);
+}
+
+/**
+ * Compress `len` bytes from `src` to `dst` (a multiple of 4 bytes, like the BIOS expects),
+ * using `work` as scratch memory (e.g. a static EWRAM_DATA one). Calls that can interrupt
+ * each other need their own `work`. Returns the compressed size, or 0 if it doesn't fit
+ * in `cap` bytes.
+ */
+static inline u32 lc_lz77_compress(const void *src, u32 len, void *dst, u32 cap, LinkLz77Work *work) {
+  const u8 *in = src;
+  u8 *out = dst;
+  if (cap < 4 || len >= (1 << 24)) {
+    return 0;
+  }
+  u32 (*heads)[2] = work->heads;
+  for (u32 i = 0; i < (1 << LINK_LZ77_HASH_BITS); i++) {
+    heads[i][0] = heads[i][1] = 0xFFFFFFFF;
+  }
+  out[0] = LINK_LZ77_TYPE;
+  out[1] = len & 0xFF;
+  out[2] = (len >> 8) & 0xFF;
+  out[3] = len >> 16;
+
+  u32 o = 4;
+  u32 i = 0;
+  while (i < len) {
+    if (o >= cap) {
+      return 0;
+    }
+    u32 flags = o++;
+    out[flags] = 0;
+    for (u32 bit = 0; bit < 8 && i < len; bit++) {
+      u32 best_len = 0, best_distance = 0;
+      if (i + 3 <= len) {
+        u32 *head = heads[lc_lz77_hash(&in[i])];
+        u32 max = len - i < 18 ? len - i : 18;
+        for (u32 c = 0; c < 2; c++) {
+          u32 distance = i - head[c];
+          if (head[c] == 0xFFFFFFFF || distance < 2 || distance > 4096) {
+            continue;
+          }
+          u32 n = 0;
+          while (n < max && in[head[c] + n] == in[i + n]) {
+            n++;
+          }
+          if (n > best_len) {
+            best_len = n;
+            best_distance = distance;
+          }
+        }
+      }
+
+      if (best_len >= 3) {
+        if (o + 2 > cap) {
+          return 0;
+        }
+        out[flags] |= 0x80 >> bit;
+        out[o++] = ((best_len - 3) << 4) | ((best_distance - 1) >> 8);
+        out[o++] = (best_distance - 1) & 0xFF;
+      } else {
+        if (o >= cap) {
+          return 0;
+        }
+        out[o++] = in[i];
+        best_len = 1;
+      }
+      for (u32 end = i + best_len; i < end; i++) {
+        if (i + 3 <= len) {
+          u32 *head = heads[lc_lz77_hash(&in[i])];
+          head[1] = head[0];
+          head[0] = i;
+        }
+      }
+    }
+  }
+  while (o & 3) {
+    if (o >= cap) {
+      return 0;
+    }
+    out[o++] = 0;
+  }
+  return o;
+}
+
+/**
+ * Start decoding into `dst`, which must be byte-writable (not VRAM) and hold `cap` bytes.
+ */
+static inline LinkLz77Decoder lc_lz77_decoder_init(void *dst, u32 cap) {
+  return (LinkLz77Decoder) {
+    .dst = dst,
+    .cap = cap,
+    .status = LINK_LZ77_NEED_INPUT,
+  };
+}
+
+/**
+ * Decode from `src`, of which the first `available` bytes are there so far (e.g. the bytes
+ * a bulk receive confirmed), writing about `budget` bytes at most. Call it again with the
+ * same `src` to go on. Returns LINK_LZ77_NEED_INPUT (wait for more bytes), _BUSY (budget
+ * used up), _DONE (`self->len` bytes written) or _ERROR (bad header, too big for `cap`,
+ * or a back-reference before the start).
+ */
+static inline u8 lc_lz77_decode(LinkLz77Decoder *self, const void *src, u32 available, u32 budget) {
+  const u8 *in = src;
+  if (self->status == LINK_LZ77_DONE || self->status == LINK_LZ77_ERROR) {
+    return self->status;
+  }
+  if (self->in == 0) {
+    if (available < 4) {
+      return self->status = LINK_LZ77_NEED_INPUT;
+    }
+    self->len = in[1] | (in[2] << 8) | (in[3] << 16);
+    if (in[0] != LINK_LZ77_TYPE || self->len > self->cap) {
+      return self->status = LINK_LZ77_ERROR;
+    }
+    self->in = 4;
+  }
+
+  u32 limit = self->len - self->out > budget ? self->out + budget : self->len;
+  while (self->out < limit) {
+    if (self->bits == 0) {
+      if (self->in >= available) {
+        return self->status = LINK_LZ77_NEED_INPUT;
+      }
+      self->flags = in[self->in++];
+      self->bits = 8;
+    }
+    if (self->flags & 0x80) {
+      if (self->in + 2 > available) {
+        return self->status = LINK_LZ77_NEED_INPUT;
+      }
+      u32 n = (in[self->in] >> 4) + 3;
+      u32 distance = (((in[self->in] & 0xF) << 8) | in[self->in + 1]) + 1;
+      if (distance > self->out) {
+        return self->status = LINK_LZ77_ERROR;
+      }
+      self->in += 2;
+      if (n > self->len - self->out) {
+        n = self->len - self->out;
+      }
+      u8 *to = &self->dst[self->out];
+      const u8 *from = to - distance;
+      for (u32 i = 0; i < n; i++) {
+        to[i] = from[i];
+      }
+      self->out += n;
+    } else {
+      if (self->in >= available) {
+        return self->status = LINK_LZ77_NEED_INPUT;
+      }
+      self->dst[self->out++] = in[self->in++];
+    }
+    self->flags <<= 1;
+    self->bits--;
+  }
+  return self->status = self->out == self->len ? LINK_LZ77_DONE : LINK_LZ77_BUSY;
+}
+#endif
+
+
 // Link State (internal)
 // ---------------------
+// Main-thread code that touches what the IRQ handlers use goes between LINK_LOCK and
+// LINK_UNLOCK (once per block), as selected by LINK_LOCK_MODE. With LINK_LOCK_IE,
+// `is_locked` is also set, for IRQs that aren't in `irq_mask`: VBlank, which the game
+// needs on time, and an external scheduler's.
+
+#define LINK_LOCK(STATE) u16 link_lock_saved = linkstate_lock(STATE)
+#define LINK_UNLOCK(STATE) linkstate_unlock(STATE, link_lock_saved)
+
+static inline u16 linkstate_lock(LinkState *self) {
+#if LINK_LOCK_MODE == LINK_LOCK_IME
+  u16 ime = REG_IME;
+  REG_IME = 0;
+  return ime;
+#elif LINK_LOCK_MODE == LINK_LOCK_IE
+  // REG_IE is changed with IRQs off, so other handlers can change it too.
+  u16 ime = REG_IME;
+  REG_IME = 0;
+  u16 masked = REG_IE & self->irq_mask;
+  REG_IE &= ~self->irq_mask;
+  self->is_locked = true;
+  REG_IME = ime;
+  return masked;
+#else
+  self->is_locked = true;
+  return 0;
+#endif
+}
+
+static inline void linkstate_unlock(LinkState *self, u16 saved) {
+#if LINK_LOCK_MODE == LINK_LOCK_IME
+  REG_IME = saved;
+#elif LINK_LOCK_MODE == LINK_LOCK_IE
+  u16 ime = REG_IME;
+  REG_IME = 0;
+  self->is_locked = false;
+  REG_IE |= saved;
+  REG_IME = ime;
+#else
+  self->is_locked = false;
+#endif
+}
 
 static inline LinkState linkstate_init(int buffer_len, u16 *buffer_mem) {
   LinkState self = {};
@@ -208,6 +1433,17 @@ static inline LinkState linkstate_init(int buffer_len, u16 *buffer_mem) {
     buf += buffer_len;
   }
   self.outgoing_messages = u16q_init(buffer_len, buf);
+#ifdef LINK_ENABLE_CHANNELS
+  buf += buffer_len;
+  for (int c = 0; c < LINK_CHANNELS - 1; c++) {
+    self.channel_out[c] = u16q_init(buffer_len, buf);
+    buf += buffer_len;
+    for (int i = 0; i < LINK_MAX_PLAYERS; i++) {
+      self.channel_in[c][i] = u16q_init(buffer_len, buf);
+      buf += buffer_len;
+    }
+  }
+#endif
   return self;
 }
 
@@ -215,20 +1451,30 @@ static inline bool linkstate_is_connected(LinkState *self) {
   return self->player_count > 1 && self->current_player_id < self->player_count;
 }
 
+// Messages that can be read (unverified packet words stay hidden).
+static inline u32 linkstate_available(LinkState *self, u8 player_id) {
+  u32 len = self->incoming_messages[player_id].len;
+#ifdef LINK_ENABLE_CRC16
+  len = len > self->rx_hidden[player_id] ? len - self->rx_hidden[player_id] : 0;
+#endif
+  return len;
+}
+
 static inline bool linkstate_has_message(LinkState *self, u8 player_id) {
   if (player_id >= self->player_count) {
     return false;
   }
-  self->is_locked = true;
-  bool has_message = !u16q_empty(&(self->incoming_messages[player_id]));
-  self->is_locked = false;
+  LINK_LOCK(self);
+  bool has_message = linkstate_available(self, player_id) > 0;
+  LINK_UNLOCK(self);
   return has_message;
 }
 
 static inline u16 linkstate_read_message(LinkState *self, u8 player_id) {
-  self->is_locked = true;
-  u16 message = LINK_QUEUE_POP(&self->incoming_messages[player_id]);
-  self->is_locked = false;
+  LINK_LOCK(self);
+  u16 message = linkstate_available(self, player_id) > 0 ? LINK_QUEUE_POP(&self->incoming_messages[player_id])
+                                                         : LINK_NO_DATA;
+  LINK_UNLOCK(self);
   return message;
 }
 
@@ -243,8 +1489,53 @@ static inline void setBitLow(u8 bit) { LINK_SET_LOW(REG_SIOCNT, bit); }
 static inline bool lc_is_ready(LinkConnection *self) { return isBitHigh(LINK_BIT_READY); }
 static inline bool lc_has_error(LinkConnection *self) { return isBitHigh(LINK_BIT_ERROR); }
 static inline bool lc_is_master(LinkConnection *self) { return !isBitHigh(LINK_BIT_SLAVE); }
+
+#ifdef LINK_ENABLE_SNAPSHOT
+// Copies the connection state to `snapshot` (only from IRQ handlers, or with them off).
+static inline void lc_publish(LinkConnection *self) {
+  LinkState *state = &self->state;
+  u8 connected = 0;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    if (state->timeouts[i] != LINK_REMOTE_TIMEOUT_OFFLINE) {
+      connected |= 1 << i;
+    }
+  }
+  self->snapshot_seq++;
+  self->snapshot.frame = self->frame;
+  self->snapshot.player_count = state->player_count;
+  self->snapshot.current_player_id = state->current_player_id;
+  self->snapshot.connected = connected;
+  self->snapshot.is_master = lc_is_master(self);
+  self->snapshot.is_connected = linkstate_is_connected(state);
+  self->snapshot_seq++;
+}
+#endif
 static inline bool lc_is_sending(LinkConnection *self) { return isBitHigh(LINK_BIT_START); }
-static inline bool lc_did_timeout(LinkConnection *self) { return self->state.irq_timeout >= self->timeout; }
+static inline bool lc_did_timeout(LinkConnection *self) {
+  if (self->state.irq_timeout >= self->timeout) {
+    return true;
+  }
+#ifdef LINK_ENABLE_TIMEOUT_US
+  // Only while someone is connected: otherwise `timeout` keeps the reset rate to a few per second.
+  if (self->timeout_ticks > 0 && self->state.player_count > 1 &&
+      lc_clock_now() - self->state.irq_time >= self->timeout_ticks) {
+    return true;
+  }
+#endif
+  return false;
+}
+
+static inline bool lc_did_remote_timeout(LinkConnection *self, u32 player_id, u32 now) {
+  if (self->state.timeouts[player_id] >= (int)self->remote_timeout) {
+    return true;
+  }
+#ifdef LINK_ENABLE_TIMEOUT_US
+  if (self->remote_timeout_ticks > 0 && now - self->state.seen_time[player_id] >= self->remote_timeout_ticks) {
+    return true;
+  }
+#endif
+  return false;
+}
 
 static inline void lc_reset_state(LinkConnection *self) {
   self->state.player_count = 0;
@@ -252,163 +1543,3066 @@ static inline void lc_reset_state(LinkConnection *self) {
   for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
     LINK_QUEUE_CLEAR(&self->state.incoming_messages[i]);
     self->state.timeouts[i] = LINK_REMOTE_TIMEOUT_OFFLINE;
+#ifdef LINK_ENABLE_DELTA
+    self->held[i] = LINK_NO_DATA;
+#endif
   }
   LINK_QUEUE_CLEAR(&self->state.outgoing_messages);
   self->state.irq_flag = false;
   self->state.irq_timeout = 0;
-}
+  self->state.failures = 0;
+#ifdef LINK_ENABLE_TIMEOUT_US
+  self->state.irq_time = lc_clock_now();
+#endif
+#ifdef LINK_ENABLE_DELTA
+  // The queued value may be gone: send the next one no matter what.
+  self->delta_last = LINK_NO_DATA;
+#endif
+#ifdef LINK_ENABLE_CONTROL
+  // (re)bound here because the connection is returned by value from `lc_init`
+  self->state.control_messages = u16q_init(LINK_CONTROL_BUFFER_LEN, self->state.control_buffer);
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->state.rx_escaped[i] = false;
+  }
+#endif
+#ifdef LINK_ENABLE_CRC16
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->state.rx_packet[i] = LINK_PACKET_NONE;
+    self->state.rx_hidden[i] = 0;
+  }
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+  for (u32 c = 0; c < LINK_CHANNELS - 1; c++) {
+    LINK_QUEUE_CLEAR(&self->state.channel_out[c]);
+    for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+      LINK_QUEUE_CLEAR(&self->state.channel_in[c][i]);
+    }
+  }
+  self->state.tx_channel = self->state.tx_head_channel = 0;
+  self->state.tx_tagged = 0;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->state.rx_channel[i] = 0;
+  }
+#endif
+#ifdef LINK_ENABLE_URGENT
+  // (re)bound here for the same reason as `control_messages`
+  self->state.urgent_messages = u16q_init(LINK_URGENT_BUFFER_LEN, self->state.urgent_buffer);
+  self->state.tx_urgent = LINK_URGENT_NONE;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->state.rx_urgent[i] = false;
+  }
+#endif
+#ifdef LINK_ENABLE_ROLLBACK
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->state.rx_input[i] = false;
+  }
+#endif
+#ifdef LINK_ENABLE_BYTES
+  // (re)bound here for the same reason
+  self->state.tx_bytes = u8q_init(LINK_BYTES_BUFFER_LEN, self->state.tx_bytes_buffer);
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->state.rx_bytes[i] = u8q_init(LINK_BYTES_BUFFER_LEN, self->state.rx_bytes_buffer[i]);
+    self->state.rx_run[i] = LINK_BYTES_NONE;
+  }
+#endif
+#ifdef LINK_ENABLE_RELIABLE
+  self->state.tx_sent = 0;
+  self->state.tx_stall = 0;
+  self->state.tx_seq = 0;
+  self->state.tx_marker = true;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->state.tx_acked[i] = 0;
+    self->state.rx_seq[i] = 0;
+    self->state.rx_pos[i] = 0;
+    self->state.rx_sync[i] = LINK_RX_FRESH;
+    self->state.rx_unacked[i] = 0;
+  }
+  self->state.ack_pending = 0;
+  // Tell everyone our sequence numbers start over.
+  u16q_push(&self->state.control_messages, LINK_CTRL(LINK_OP_SYNC, LINK_SYNC_ALL));
+#endif
+#ifdef LINK_ENABLE_PING
+  self->ping_waiting = 0;
+#endif
+#ifdef LINK_ENABLE_CHECKSUM
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->check_tag[i] = -1;
+  }
+#endif
+#ifdef LINK_ENABLE_BULK
+  // The sender starts its chunk over (receivers keep parsing theirs, so it doesn't leak as messages).
+  if (self->bulk_tx.status == LINK_BULK_ACTIVE) {
+    self->bulk_tx.phase = LINK_BULK_TX_BEGIN;
+    self->bulk_tx.pending = 0;
+  }
+#endif
+}
+
+static inline void lc_push(LinkConnection *self, U16Queue *q, u16 value) {
+  if (q->len >= self->buffer_len) {
+    LINK_QUEUE_POP(q);
+    LINK_STAT_ADD(self, queue_overflows);
+  }
+  u16q_push(q, value);
+}
+
+#ifdef LINK_ENABLE_CONTROL
+static inline void lc_push_control(LinkConnection *self, u16 word) {
+  if (self->state.control_messages.len < LINK_CONTROL_BUFFER_LEN) {
+    u16q_push(&self->state.control_messages, word);
+  } else {
+    LINK_STAT_ADD(self, queue_overflows);
+  }
+}
+#endif
+
+// Channels (internal)
+// -------------------
+// `outgoing_messages` holds what's on its way out. Channel 0 (`lc_send`, packets and
+// bytes) is queued there directly; the other channels wait in `channel_out` and a
+// word joins it only when it has nothing left to send, so channel 0 never waits
+// behind more than one. A CHANNEL(c) word precedes the first word of a different
+// channel, and receivers route everything after it to that channel.
+// Without reliable delivery, both sides go back to channel 0 when the sender is idle.
+// After a transfer error, the lost word could be a CHANNEL word, so every receiver
+// discards words until the next one (even on channel 0: the sender could have just
+// switched away from it). It's repeated every LINK_CHANNEL_RETAG words of channels 1+,
+// so after that many without one, or once the sender is idle, it's on channel 0.
+// With reliable delivery, a CHANNEL_SYNC follows every SEQ marker, for receivers
+// that take the stream from there (e.g. after a reset).
+
+#ifdef LINK_ENABLE_CHANNELS
+// Words in `outgoing_messages` that weren't sent yet.
+static inline u32 lc_channels_unsent(LinkConnection *self) {
+#ifdef LINK_ENABLE_RELIABLE
+  return self->state.outgoing_messages.len - self->state.tx_sent;
+#else
+  return self->state.outgoing_messages.len;
+#endif
+}
+
+// Words needed in `outgoing_messages` before the next word of `channel`.
+static inline u32 lc_channels_tag_len(LinkConnection *self, u8 channel) {
+  LinkState *state = &self->state;
+#ifndef LINK_ENABLE_RELIABLE
+  if (channel > 0 && state->tx_tagged >= LINK_CHANNEL_RETAG) {
+    return 1;
+  }
+#endif
+  return state->tx_channel != channel;
+}
+
+static inline void lc_channels_tag(LinkConnection *self, u8 channel) {
+  LinkState *state = &self->state;
+  if (lc_channels_tag_len(self, channel) > 0) {
+    u16q_push(&state->outgoing_messages, LINK_CTRL(LINK_OP_CHANNEL, channel));
+    state->tx_channel = channel;
+    state->tx_tagged = 0;
+  }
+  if (channel > 0) {
+    state->tx_tagged++;
+  }
+}
+
+// Channel of the word `index` places after the head of `outgoing_messages`.
+static inline u8 lc_channels_at(LinkConnection *self, u32 index) {
+  U16Queue *q = &self->state.outgoing_messages;
+  u8 channel = self->state.tx_head_channel;
+  for (u32 n = 0, i = q->i; n < index && n < q->len; n++) {
+    // Escaped words are below 0x8000, so this is always a real CHANNEL word.
+    if (q->buf[i] >= LINK_CTRL_BASE && LINK_CTRL_OP(q->buf[i]) == LINK_OP_CHANNEL) {
+      channel = LINK_CTRL_ARG(q->buf[i]);
+    }
+    if (++i >= q->cap) {
+      i = 0;
+    }
+  }
+  return channel;
+}
+
+// The next channel (1+) to send from: strict ones (weight 0) in order, then a smooth
+// weighted round robin between the others. Returns 0 if they're all empty.
+static inline u8 lc_channels_pick(LinkConnection *self) {
+  u8 best = 0;
+  s16 total = 0;
+  for (u32 c = 1; c < LINK_CHANNELS; c++) {
+    if (u16q_empty(&self->state.channel_out[c - 1])) {
+      continue;
+    }
+    if (self->channel_weight[c] == 0) {
+      return c;
+    }
+    self->channel_credit[c] += self->channel_weight[c];
+    total += self->channel_weight[c];
+    if (best == 0 || self->channel_credit[c] > self->channel_credit[best]) {
+      best = c;
+    }
+  }
+  if (best > 0) {
+    self->channel_credit[best] -= total;
+  }
+  return best;
+}
+
+// Moves the next word of channels 1+ to `outgoing_messages` if it has nothing else to send.
+static inline bool lc_channels_feed(LinkConnection *self) {
+  U16Queue *q = &self->state.outgoing_messages;
+  if (lc_channels_unsent(self) > 0 || q->len + 3 > self->buffer_len) {
+    return false;
+  }
+  u8 channel = lc_channels_pick(self);
+  if (channel == 0) {
+    return false;
+  }
+  u16 data = LINK_QUEUE_POP(&self->state.channel_out[channel - 1]);
+  lc_channels_tag(self, channel);
+  if (data >= LINK_CTRL_BASE) {
+    u16q_push(q, LINK_CTRL_ESCAPE);
+    data ^= LINK_ESCAPE_MASK;
+  }
+  u16q_push(q, data);
+  LINK_STAT_MAX(self, outgoing_high_water, q->len);
+  return true;
+}
+
+// Called when words leave the head of `outgoing_messages` for good.
+static inline void lc_channels_on_release(LinkConnection *self, u32 count) {
+  LinkState *state = &self->state;
+  state->tx_head_channel = lc_channels_at(self, count);
+}
+
+// Nothing was queued, so both sides are back to channel 0.
+static inline void lc_channels_on_idle_sent(LinkConnection *self) {
+#ifndef LINK_ENABLE_RELIABLE
+  self->state.tx_channel = self->state.tx_head_channel = 0;
+#endif
+}
+
+// Where words from `player` go now.
+static inline U16Queue *lc_channels_queue(LinkConnection *self, u8 player) {
+  u8 channel = self->state.rx_channel[player];
+  if (channel > 0 && channel < LINK_CHANNELS) {
+    return &self->state.channel_in[channel - 1][player];
+  }
+  return &self->state.incoming_messages[player];
+}
+
+static inline void lc_channels_on_control(LinkConnection *self, u8 player, u16 word) {
+  LinkState *state = &self->state;
+  u8 op = LINK_CTRL_OP(word);
+  u8 channel = LINK_CTRL_ARG(word);
+  if (op == LINK_OP_CHANNEL) {
+    state->rx_channel[player] = channel < LINK_CHANNELS ? channel : LINK_CHANNEL_LOST;
+    state->rx_channel_lost[player] = 0;
+  }
+#ifdef LINK_ENABLE_RELIABLE
+  // Only if the SEQ marker moved us to where the sender is (not for repeated words).
+  if (op == LINK_OP_CHANNEL_SYNC && state->rx_sync[player] == LINK_RX_SYNCED &&
+      state->rx_pos[player] == state->rx_seq[player] && channel < LINK_CHANNELS) {
+    state->rx_channel[player] = channel;
+  }
+#endif
+}
+
+// Returns true if the word was taken (for channels 1+, or discarded).
+static inline bool lc_channels_on_word(LinkConnection *self, u8 player, u16 data) {
+  LinkState *state = &self->state;
+  u8 channel = state->rx_channel[player];
+  if (channel == LINK_CHANNEL_LOST) {
+    if (++state->rx_channel_lost[player] <= LINK_CHANNEL_RETAG) {
+      return true;
+    }
+    // Channels 1+ would have been tagged again by now.
+    state->rx_channel[player] = 0;
+    return false;
+  }
+  if (channel == 0) {
+    return false;
+  }
+  U16Queue *q = lc_channels_queue(self, player);
+  lc_push(self, q, data);
+  return true;
+}
+
+static inline void lc_channels_on_idle(LinkConnection *self, u8 player) {
+#ifndef LINK_ENABLE_RELIABLE
+  self->state.rx_channel[player] = 0;
+#endif
+}
+
+// The failed transfer lost a word from every player (unless it will be retransmitted).
+static inline void lc_channels_on_error(LinkConnection *self) {
+#ifndef LINK_ENABLE_RELIABLE
+  LinkState *state = &self->state;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    state->rx_channel[i] = LINK_CHANNEL_LOST;
+    state->rx_channel_lost[i] = 0;
+  }
+#endif
+}
+#endif
+
+// Urgent messages (internal)
+// --------------------------
+// `lc_send_urgent` messages wait in `urgent_messages`, which is sent before anything
+// but out-of-band words (and the rest of a bulk chunk). Each one goes out as URGENT
+// and the message back to back, even in the middle of a packet or a byte run, and
+// receivers take it out of the stream before anything else sees it. Messages in the
+// control range are sent as URGENT(LINK_URGENT_ESCAPED) and the message XORed with
+// LINK_ESCAPE_MASK, so nothing after an URGENT looks like a control word. They're outside
+// the reliable stream too (sequence numbers don't count them): if the sender sees a
+// transfer error on either word, it repeats both (so receivers that saw the message get
+// it twice), but one that only receivers saw loses the message. A control word where
+// the message should be means the sender started over.
+
+#ifdef LINK_ENABLE_URGENT
+// The word sent last went through.
+static inline void lc_urgent_on_sent(LinkConnection *self) {
+  LinkState *state = &self->state;
+  if (state->tx_urgent == LINK_URGENT_MESSAGE) {
+    u16q_pop(&state->urgent_messages);
+    state->tx_urgent = LINK_URGENT_NONE;
+  }
+}
+
+static inline u16 lc_urgent_next(LinkConnection *self) {
+  LinkState *state = &self->state;
+  u16 message = u16q_front(&state->urgent_messages);
+  bool escaped = message >= LINK_CTRL_BASE;
+  if (state->tx_urgent == LINK_URGENT_NONE) {
+    state->tx_urgent = LINK_URGENT_WORD;
+    return LINK_CTRL(LINK_OP_URGENT, escaped ? LINK_URGENT_ESCAPED : 0);
+  }
+  state->tx_urgent = LINK_URGENT_MESSAGE;
+  return escaped ? message ^ LINK_ESCAPE_MASK : message;
+}
+
+// Returns true if the word was taken (as an URGENT word or the message after it).
+static inline bool lc_urgent_on_word(LinkConnection *self, u8 player, u16 data) {
+  LinkState *state = &self->state;
+  if (!state->rx_urgent[player] || data == LINK_NO_DATA || data >= LINK_CTRL_BASE) {
+    // Messages never look like that: after an URGENT word, the sender started over.
+    state->rx_urgent[player] =
+        data == LINK_CTRL(LINK_OP_URGENT, 0) || data == LINK_CTRL(LINK_OP_URGENT, LINK_URGENT_ESCAPED);
+    state->rx_urgent_escaped[player] = LINK_CTRL_ARG(data) == LINK_URGENT_ESCAPED;
+    return state->rx_urgent[player];
+  }
+  state->rx_urgent[player] = false;
+  U16Queue *q = &state->incoming_messages[player];
+  lc_push(self, q, state->rx_urgent_escaped[player] ? data ^ LINK_ESCAPE_MASK : data);
+#ifdef LINK_ENABLE_CRC16
+  // Ahead of the packet being received, which isn't complete yet.
+  if (state->rx_packet[player] == LINK_PACKET_DATA) {
+    u16q_sink(q, state->rx_hidden[player]);
+  }
+#endif
+  LINK_STAT_MAX(self, incoming_high_water[player], q->len);
+  return true;
+}
+
+// The failed transfer lost the words in it, so the front message starts over.
+static inline void lc_urgent_on_error(LinkConnection *self) {
+  self->state.tx_urgent = LINK_URGENT_NONE;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->state.rx_urgent[i] = false;
+  }
+}
+#endif
+
+// Events (internal)
+// ------------------
+// The IRQ handlers add events to a ring, which overwrites the oldest one when it's
+// full. With callbacks `from_irq`, they go straight to the callbacks instead, and new
+// messages are handed over at the end of each serial IRQ.
+
+#ifdef LINK_ENABLE_EVENTS
+#ifdef LINK_ENABLE_CALLBACKS
+static inline void lc_callbacks_on_event(LinkCallbacks *callbacks, const LinkEvent *event) {
+  if (callbacks->on_event) {
+    callbacks->on_event(callbacks->context, event);
+  }
+  if (event->type == LINK_EVENT_RESET && callbacks->on_reset) {
+    callbacks->on_reset(callbacks->context, event->detail);
+  } else if (event->type == LINK_EVENT_JOINED && callbacks->on_connected) {
+    callbacks->on_connected(callbacks->context, event->player_id);
+  } else if (event->type == LINK_EVENT_LEFT && callbacks->on_disconnected) {
+    callbacks->on_disconnected(callbacks->context, event->player_id);
+  }
+}
+
+static inline void lc_callbacks_on_transfer(LinkConnection *self) {
+  LinkCallbacks *callbacks = &self->callbacks;
+  if (!callbacks->from_irq || !callbacks->on_message) {
+    return;
+  }
+  LinkState *state = &self->state;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    while (i != state->current_player_id && linkstate_available(state, i) > 0) {
+      callbacks->on_message(callbacks->context, i, LINK_QUEUE_POP(&state->incoming_messages[i]));
+    }
+  }
+}
+#endif
+
+static inline void lc_events_push(LinkConnection *self, u8 type, u8 player_id, u8 detail) {
+  LinkEvent event = {.type = type, .player_id = player_id, .detail = detail, .frame = self->frame};
+#ifdef LINK_ENABLE_CALLBACKS
+  if (self->callbacks.from_irq) {
+    lc_callbacks_on_event(&self->callbacks, &event);
+    return;
+  }
+#endif
+  if (self->event_count == LINK_EVENT_BUFFER_LEN) {
+    self->event_next = (self->event_next + 1) % LINK_EVENT_BUFFER_LEN;
+    self->event_count--;
+    self->events_dropped++;
+  }
+  self->events[(self->event_next + self->event_count) % LINK_EVENT_BUFFER_LEN] = event;
+  self->event_count++;
+}
+
+// Called for every good transfer, with `current_player_id` up to date.
+static inline void lc_events_on_transfer(LinkConnection *self) {
+  u8 player_id = self->state.current_player_id;
+  u8 role = lc_is_master(self);
+  if (role != self->event_role) {
+    self->event_role = role;
+    lc_events_push(self, LINK_EVENT_ROLE, player_id, role);
+  }
+  if (player_id != self->event_player_id) {
+    self->event_player_id = player_id;
+    lc_events_push(self, LINK_EVENT_PLAYER_ID, player_id, 0);
+  }
+}
+
+static inline void lc_events_on_reset(LinkConnection *self, u8 reason) {
+  self->event_role = self->event_player_id = 0xFF;
+  lc_events_push(self, LINK_EVENT_RESET, 0, reason);
+}
+#endif
+
+// Reliable delivery (internal)
+// ----------------------------
+// Every queued word gets an implicit 4-bit sequence number. Sent words stay in
+// `outgoing_messages` until all connected players acknowledge them; a SEQ marker
+// precedes the first word after a (re)transmission so receivers can drop duplicates.
+
+#ifdef LINK_ENABLE_RELIABLE
+static inline void lc_reliable_schedule_ack(LinkConnection *self, u8 player) {
+  if (self->state.ack_pending & (1 << player)) {
+    return;
+  }
+  if (self->state.control_messages.len < LINK_CONTROL_BUFFER_LEN) {
+    // The sequence number is filled in when the word is actually sent.
+    self->state.ack_pending |= 1 << player;
+    u16q_push(&self->state.control_messages, LINK_CTRL(LINK_OP_ACK + player, 0));
+  }
+}
+
+static inline void lc_reliable_lose(LinkConnection *self, u8 player) {
+  self->state.rx_sync[player] = LINK_RX_LOST;
+  lc_reliable_schedule_ack(self, player);
+}
+
+static inline void lc_reliable_release(LinkConnection *self) {
+  LinkState *state = &self->state;
+  u32 release = LINK_RELIABLE_WINDOW;
+  bool has_peers = false;
+
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    if (i == state->current_player_id || state->timeouts[i] == LINK_REMOTE_TIMEOUT_OFFLINE) {
+      continue;
+    }
+    u32 acked = (state->tx_acked[i] - state->tx_seq) & LINK_RELIABLE_SEQ_MASK;
+    if (acked < release) {
+      release = acked;
+    }
+    has_peers = true;
+  }
+  if (!has_peers || release == 0) {
+    return;
+  }
+
+#ifdef LINK_ENABLE_CHANNELS
+  lc_channels_on_release(self, release);
+#endif
+  for (u32 i = 0; i < release; i++) {
+    u16q_pop(&state->outgoing_messages);
+  }
+  state->tx_seq = (state->tx_seq + release) & LINK_RELIABLE_SEQ_MASK;
+  if (release > state->tx_sent) {
+    state->tx_sent = 0;
+    state->tx_marker = true;
+  } else {
+    state->tx_sent -= release;
+  }
+  state->tx_stall = 0;
+}
+
+static inline void lc_reliable_restart(LinkConnection *self, u8 player) {
+  // Resend everything unacknowledged, asking `player` to take the next SEQ marker as is.
+  self->state.tx_acked[player] = self->state.tx_seq;
+  self->state.tx_sent = 0;
+  self->state.tx_marker = true;
+  lc_push_control(self, LINK_CTRL(LINK_OP_SYNC, player));
+  LINK_STAT_ADD(self, retransmissions);
+}
+
+static inline void lc_reliable_on_connect(LinkConnection *self, u8 player) {
+  lc_reliable_restart(self, player);
+  self->state.rx_sync[player] = LINK_RX_FRESH;
+  self->state.rx_unacked[player] = 0;
+  self->state.rx_escaped[player] = false;
+}
+
+static inline void lc_reliable_on_control(LinkConnection *self, u8 player, u16 data) {
+  LinkState *state = &self->state;
+  u8 op = LINK_CTRL_OP(data);
+  u8 seq = LINK_CTRL_ARG(data);
+
+  if (op == LINK_OP_SEQ) {
+    u32 behind = (state->rx_seq[player] - seq) & LINK_RELIABLE_SEQ_MASK;
+    if (state->rx_sync[player] == LINK_RX_FRESH) {
+      return;
+    } else if (state->rx_sync[player] == LINK_RX_ARMED) {
+      state->rx_seq[player] = seq;
+      state->rx_escaped[player] = false;
+    } else if (behind > LINK_RELIABLE_WINDOW) {
+      // Resuming after words we never got (another player asked for it).
+      lc_reliable_lose(self, player);
+      return;
+    } else if (behind > 0) {
+      // The sender is repeating words we already have: it missed our last ack.
+      lc_reliable_schedule_ack(self, player);
+    }
+    state->rx_pos[player] = seq;
+    state->rx_sync[player] = LINK_RX_SYNCED;
+    return;
+  }
+  if (op == LINK_OP_SYNC) {
+    if (seq == LINK_SYNC_ALL || seq == state->current_player_id) {
+      state->rx_sync[player] = LINK_RX_ARMED;
+    }
+    return;
+  }
+  if (op == LINK_OP_REQ) {
+    if (seq == state->current_player_id) {
+      lc_reliable_restart(self, player);
+    }
+    return;
+  }
+
+  bool is_nak = op >= LINK_OP_NAK;
+  u8 target = op - (is_nak ? LINK_OP_NAK : LINK_OP_ACK);
+  if (target != state->current_player_id) {
+    return;
+  }
+  u32 acked = (seq - state->tx_seq) & LINK_RELIABLE_SEQ_MASK;
+  if (acked > LINK_RELIABLE_WINDOW || acked > state->outgoing_messages.len) {
+    if (is_nak) {
+      // It's missing words that were already released: it can only start over.
+      lc_reliable_restart(self, player);
+    }
+    return;
+  }
+  state->tx_acked[player] = seq;
+  if (is_nak && acked < state->tx_sent) {
+    state->tx_sent = acked;
+    state->tx_marker = true;
+    LINK_STAT_ADD(self, retransmissions);
+  }
+  lc_reliable_release(self);
+}
+
+static inline bool lc_reliable_accept(LinkConnection *self, u8 player) {
+  LinkState *state = &self->state;
+  if (state->rx_sync[player] == LINK_RX_ARMED) {
+    // Missed the SEQ marker.
+    state->rx_sync[player] = LINK_RX_FRESH;
+  }
+  if (state->rx_sync[player] == LINK_RX_FRESH) {
+    if (++state->rx_unacked[player] >= LINK_RELIABLE_ACK_EVERY) {
+      lc_reliable_schedule_ack(self, player);
+    }
+    return false;
+  }
+  if (state->rx_sync[player] != LINK_RX_SYNCED) {
+    return false;
+  }
+
+  u32 behind = (state->rx_seq[player] - state->rx_pos[player]) & LINK_RELIABLE_SEQ_MASK;
+  if (behind > 0) {
+    if (behind > LINK_RELIABLE_WINDOW) {
+      lc_reliable_lose(self, player);
+    } else {
+      state->rx_pos[player] = (state->rx_pos[player] + 1) & LINK_RELIABLE_SEQ_MASK;
+    }
+    return false;
+  }
+#ifdef LINK_ENABLE_CHANNELS
+  U16Queue *q = lc_channels_queue(self, player);
+#else
+  U16Queue *q = &state->incoming_messages[player];
+#endif
+  if (q->len >= self->buffer_len) {
+    // No room: let the sender retransmit once the game reads some messages.
+    lc_reliable_lose(self, player);
+    return false;
+  }
+
+  state->rx_seq[player] = state->rx_pos[player] = (state->rx_pos[player] + 1) & LINK_RELIABLE_SEQ_MASK;
+  if (++state->rx_unacked[player] >= LINK_RELIABLE_ACK_EVERY) {
+    lc_reliable_schedule_ack(self, player);
+  }
+  return true;
+}
+
+static inline u16 lc_reliable_next_control(LinkConnection *self) {
+  LinkState *state = &self->state;
+  u16 word = LINK_QUEUE_POP(&state->control_messages);
+  u8 op = LINK_CTRL_OP(word);
+
+  if (word >= LINK_CTRL_BASE && word < LINK_CTRL_STREAM_BASE && op >= LINK_OP_ACK && op < LINK_OP_ACK + LINK_MAX_PLAYERS) {
+    u8 player = op - LINK_OP_ACK;
+    state->ack_pending &= ~(1 << player);
+    state->rx_unacked[player] = 0;
+    switch (state->rx_sync[player]) {
+      case LINK_RX_SYNCED: word = LINK_CTRL(LINK_OP_ACK + player, state->rx_seq[player]); break;
+      case LINK_RX_LOST: word = LINK_CTRL(LINK_OP_NAK + player, state->rx_seq[player]); break;
+      default: word = LINK_CTRL(LINK_OP_REQ, player); break;
+    }
+  }
+  return word;
+}
+
+static inline u16 lc_reliable_next(LinkConnection *self) {
+  LinkState *state = &self->state;
+  U16Queue *q = &state->outgoing_messages;
+
+  if (state->tx_sent >= q->len || state->tx_sent >= LINK_RELIABLE_WINDOW) {
+    if (state->tx_sent > 0 && ++state->tx_stall >= LINK_RELIABLE_RETRY) {
+      state->tx_stall = 0;
+      state->tx_sent = 0;
+      state->tx_marker = true;
+      LINK_STAT_ADD(self, retransmissions);
+    }
+    return LINK_NO_DATA;
+  }
+  if (state->tx_marker) {
+    state->tx_marker = false;
+#ifdef LINK_ENABLE_CHANNELS
+    // Out-of-band words go first, so this is the next one after the marker.
+    lc_push_control(self, LINK_CTRL(LINK_OP_CHANNEL_SYNC, lc_channels_at(self, state->tx_sent)));
+#endif
+    return LINK_CTRL(LINK_OP_SEQ, (state->tx_seq + state->tx_sent) & LINK_RELIABLE_SEQ_MASK);
+  }
+
+  u32 index = q->i + state->tx_sent;
+  if (index >= q->cap) {
+    index -= q->cap;
+  }
+  state->tx_sent++;
+  return q->buf[index];
+}
+
+static inline void lc_reliable_on_error(LinkConnection *self) {
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    if (i != self->state.current_player_id && self->state.rx_sync[i] == LINK_RX_SYNCED) {
+      lc_reliable_lose(self, i);
+    }
+  }
+}
+#endif
+
+// Latency probe (internal)
+// ------------------------
+// A PING travels in the message stream (so it waits behind queued messages, like
+// real data would) and every player answers right away with an out-of-band PONG.
+
+#ifdef LINK_ENABLE_PING
+static inline void lc_ping_on_pong(LinkConnection *self, u8 player, u16 word) {
+  u8 arg = LINK_CTRL_ARG(word);
+  if ((arg >> 2) != self->state.current_player_id || (arg & LINK_PING_SEQ_MASK) != self->ping_seq ||
+      !(self->ping_waiting & (1 << player))) {
+    return;
+  }
+  self->ping_waiting &= ~(1 << player);
+
+  u32 rtt = lc_clock_now() - self->ping_time;
+  LinkLatency *latency = &self->latency[player];
+  if (latency->count == 0) {
+    latency->min = latency->max = latency->average = rtt;
+  } else {
+    if (rtt < latency->min) latency->min = rtt;
+    if (rtt > latency->max) latency->max = rtt;
+    latency->average = latency->average - (latency->average >> 3) + (rtt >> 3);
+  }
+  latency->last = rtt;
+  latency->count++;
+
+  u32 bucket = 0;
+  while (bucket < LINK_PING_BUCKETS - 1 && rtt >= (u32)LINK_PING_BUCKET_TICKS << bucket) {
+    bucket++;
+  }
+  latency->histogram[bucket]++;
+}
+#endif
+
+// Packets (internal)
+// ------------------
+// PACKET, the payload (escaped like any message), the CRC16 as two LINK_CRC16_WORD
+// words and PACKET_END. Words are queued as they arrive but stay hidden from
+// `lc_read_message` until the CRC matches; otherwise they're removed again.
+// A transfer error can swallow any of these words, so after one, the words of a
+// player that was in the middle of a packet are discarded until it starts another
+// or goes idle: they could be the rest of one that lost its start.
+
+#ifdef LINK_ENABLE_CRC16
+static inline void lc_packet_abort(LinkConnection *self, u8 player) {
+  LinkState *state = &self->state;
+  if (state->rx_packet[player] == LINK_PACKET_DATA) {
+    u16q_drop_back(&state->incoming_messages[player], state->rx_hidden[player]);
+    self->packets_dropped++;
+  }
+  state->rx_hidden[player] = 0;
+  state->rx_packet[player] = LINK_PACKET_NONE;
+}
+
+static inline void lc_packet_end(LinkConnection *self, u8 player) {
+  LinkState *state = &self->state;
+  u16 crc = state->rx_crc[player];
+  if (state->rx_hidden[player] < 2 || state->rx_tail[player][0] != LINK_CRC16_WORD(crc >> 8) ||
+      state->rx_tail[player][1] != LINK_CRC16_WORD(crc & 0xFF)) {
+    lc_packet_abort(self, player);
+    return;
+  }
+  u16q_drop_back(&state->incoming_messages[player], 2);
+  state->rx_hidden[player] = 0;
+  state->rx_packet[player] = LINK_PACKET_NONE;
+  self->packets_received++;
+}
+
+static inline void lc_packet_on_control(LinkConnection *self, u8 player, u16 word) {
+  LinkState *state = &self->state;
+  u8 op = LINK_CTRL_OP(word);
+  if (op == LINK_OP_PACKET) {
+    lc_packet_abort(self, player);
+    state->rx_packet[player] = LINK_PACKET_DATA;
+    state->rx_crc[player] = LINK_CRC16_INIT;
+  } else if (op == LINK_OP_PACKET_END) {
+    if (state->rx_packet[player] == LINK_PACKET_DATA) {
+      lc_packet_end(self, player);
+    } else if (state->rx_packet[player] == LINK_PACKET_LOST) {
+      // Already counted when the error broke it.
+      lc_packet_abort(self, player);
+    }
+  }
+}
+
+// Returns true if the word must be discarded.
+static inline bool lc_packet_on_word(LinkConnection *self, u8 player, u16 data) {
+  LinkState *state = &self->state;
+  switch (state->rx_packet[player]) {
+    case LINK_PACKET_DATA:
+      if (state->rx_hidden[player] >= 2) {
+        state->rx_crc[player] = lc_crc16_update(state->rx_crc[player], state->rx_tail[player][0]);
+      }
+      state->rx_tail[player][0] = state->rx_tail[player][1];
+      state->rx_tail[player][1] = data;
+      state->rx_hidden[player]++;
+      return false;
+    case LINK_PACKET_LOST:
+      // No packet is longer than the queue: anything after that is a message again.
+      if (++state->rx_hidden[player] >= self->buffer_len) {
+        lc_packet_abort(self, player);
+      }
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Packets are queued in one piece, so they're sent back to back: an idle
+// player is never in the middle of one. (Reliable delivery can pause anywhere.)
+static inline void lc_packet_on_idle(LinkConnection *self, u8 player) {
+#ifndef LINK_ENABLE_RELIABLE
+  lc_packet_abort(self, player);
+#endif
+}
+
+// The failed transfer lost a word from every player (unless it will be retransmitted).
+static inline void lc_packet_on_error(LinkConnection *self) {
+#ifndef LINK_ENABLE_RELIABLE
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    if (self->state.rx_packet[i] != LINK_PACKET_NONE) {
+      lc_packet_abort(self, i);
+      self->state.rx_packet[i] = LINK_PACKET_LOST;
+    }
+  }
+#endif
+}
+#endif
+
+// Byte streams (internal)
+// -----------------------
+// Bytes wait in `tx_bytes` until a VBlank, a full run, or a timer tick that would
+// otherwise send nothing. Then they join the outgoing queue as runs: BYTES or
+// BYTES_ODD(words - 1), then the words (first byte in the high half, escaped like
+// any message, so 0x0000 and 0xFFFF are fine). Receivers unpack them into `rx_bytes`.
+// Reliable delivery (always on with LINK_ENABLE_BYTES) retransmits a word swallowed
+// by a transfer error, so runs arrive whole and in order.
+
+#ifdef LINK_ENABLE_BYTES
+static inline u16 lc_bytes_pair(U8Queue *q, u32 n, u32 count) {
+  return n + 1 < count ? (u8q_at(q, n) << 8) | u8q_at(q, n + 1) : u8q_at(q, n) << 8;
+}
+
+static inline bool lc_bytes_needs_escape(u16 word) {
+  return word == LINK_NO_DATA || word >= LINK_CTRL_BASE;
+}
+
+// Moves waiting bytes to the outgoing queue, one run at a time, while they fit.
+static inline void lc_bytes_flush(LinkConnection *self) {
+  U8Queue *tx = &self->state.tx_bytes;
+  U16Queue *q = &self->state.outgoing_messages;
+  while (tx->len > 0) {
+    u32 count = tx->len < LINK_BYTES_RUN * 2 ? tx->len : LINK_BYTES_RUN * 2;
+    u32 words = (count + 1) / 2;
+    u32 needed = 1 + words;
+    for (u32 n = 0; n < count; n += 2) {
+      needed += lc_bytes_needs_escape(lc_bytes_pair(tx, n, count));
+    }
+#ifdef LINK_ENABLE_CHANNELS
+    needed += lc_channels_tag_len(self, 0);
+#endif
+    if (q->len + needed > self->buffer_len) {
+      return;
+    }
+#ifdef LINK_ENABLE_CHANNELS
+    lc_channels_tag(self, 0);
+#endif
+    u16q_push(q, LINK_CTRL(count & 1 ? LINK_OP_BYTES_ODD : LINK_OP_BYTES, words - 1));
+    for (u32 n = 0; n < count; n += 2) {
+      u16 word = lc_bytes_pair(tx, n, count);
+      if (lc_bytes_needs_escape(word)) {
+        u16q_push(q, LINK_CTRL_ESCAPE);
+        word ^= LINK_ESCAPE_MASK;
+      }
+      u16q_push(q, word);
+    }
+    for (u32 n = 0; n < count; n++) {
+      u8q_pop(tx);
+    }
+    LINK_STAT_MAX(self, outgoing_high_water, q->len);
+  }
+}
+
+static inline void lc_bytes_on_control(LinkConnection *self, u8 player, u16 word) {
+  LinkState *state = &self->state;
+  u8 op = LINK_CTRL_OP(word);
+  if (op == LINK_OP_BYTES || op == LINK_OP_BYTES_ODD) {
+    state->rx_run[player] = LINK_BYTES_DATA;
+    state->rx_run_left[player] = LINK_CTRL_ARG(word) + 1;
+    state->rx_run_odd[player] = op == LINK_OP_BYTES_ODD;
+  }
+}
+
+// Returns true if the word was taken as bytes.
+static inline bool lc_bytes_on_word(LinkConnection *self, u8 player, u16 data) {
+  LinkState *state = &self->state;
+  if (state->rx_run[player] == LINK_BYTES_NONE) {
+    return false;
+  }
+  bool is_last = --state->rx_run_left[player] == 0;
+  if (is_last) {
+    state->rx_run[player] = LINK_BYTES_NONE;
+  }
+  U8Queue *q = &state->rx_bytes[player];
+  u32 count = is_last && state->rx_run_odd[player] ? 1 : 2;
+  for (u32 n = 0; n < count; n++) {
+    if (q->len < q->cap) {
+      u8q_push(q, n == 0 ? data >> 8 : data & 0xFF);
+    } else {
+      self->bytes_dropped++;
+      LINK_STAT_ADD(self, queue_overflows);
+    }
+  }
+  return true;
+}
+#endif
+
+// Bulk transfers (internal)
+// -------------------------
+// A blob goes out in chunks: BULK(chunk & 0xF), LINK_CRC16_WORD(words), the words
+// (XORed with LINK_BULK_WHITEN and escaped), then their CRC16 as two LINK_CRC16_WORD
+// words. Chunk 0 carries the length in bytes. Words are read from the blob as they're
+// sent, and a started chunk goes out back to back (only out-of-band words cut in).
+// Then the sender waits for a BULK_REPLY from every connected player: a NAK or a
+// timeout sends the chunk again. Receivers only count a chunk if its CRC matches.
+
+#ifdef LINK_ENABLE_BULK
+static inline u32 lc_bulk_chunks(u32 len) {
+  return 1 + ((len + 1) / 2 + LINK_BULK_CHUNK - 1) / LINK_BULK_CHUNK;
+}
+
+static inline u32 lc_bulk_chunk_words(u32 len, u32 chunk) {
+  if (chunk == 0) {
+    return 2;
+  }
+  u32 left = (len + 1) / 2 - (chunk - 1) * LINK_BULK_CHUNK;
+  return left < LINK_BULK_CHUNK ? left : LINK_BULK_CHUNK;
+}
+
+// Bytes confirmed so far.
+static inline u32 lc_bulk_done(LinkBulk *bulk) {
+  if (bulk->status == LINK_BULK_DONE) {
+    return bulk->len;
+  }
+  u32 done = bulk->chunk > 1 ? (bulk->chunk - 1) * LINK_BULK_CHUNK * 2 : 0;
+  return done < bulk->len ? done : bulk->len;
+}
+
+// Byte accesses only: SRAM can't be read or written 16 bits at a time.
+static inline u16 lc_bulk_read(LinkBulk *tx) {
+  if (tx->chunk == 0) {
+    return tx->pos == 0 ? tx->len & 0xFFFF : tx->len >> 16;
+  }
+  u32 offset = ((tx->chunk - 1) * LINK_BULK_CHUNK + tx->pos) * 2;
+  return offset + 1 < tx->len ? tx->src[offset] | (tx->src[offset + 1] << 8) : tx->src[offset];
+}
+
+static inline void lc_bulk_write(LinkBulk *rx, u16 word) {
+  if (rx->current == 0) {
+    rx->length[rx->pos] = word;
+    return;
+  }
+  u32 offset = ((rx->current - 1) * LINK_BULK_CHUNK + rx->pos) * 2;
+  rx->dst[offset] = word & 0xFF;
+  if (offset + 1 < rx->len) {
+    rx->dst[offset + 1] = word >> 8;
+  }
+}
+
+static inline u8 lc_bulk_players(LinkConnection *self) {
+  u8 players = 0;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    if (i != self->state.current_player_id && self->state.timeouts[i] != LINK_REMOTE_TIMEOUT_OFFLINE) {
+      players |= 1 << i;
+    }
+  }
+  return players;
+}
+
+static inline bool lc_bulk_is_sending(LinkConnection *self) {
+  LinkBulk *tx = &self->bulk_tx;
+  return tx->status == LINK_BULK_ACTIVE && tx->phase != LINK_BULK_TX_BEGIN && tx->phase != LINK_BULK_TX_WAIT;
+}
+
+static inline bool lc_bulk_can_start(LinkConnection *self) {
+  return self->bulk_tx.status == LINK_BULK_ACTIVE && self->bulk_tx.phase == LINK_BULK_TX_BEGIN;
+}
+
+static inline u16 lc_bulk_next(LinkConnection *self) {
+  LinkBulk *tx = &self->bulk_tx;
+  if (tx->pending != 0) {
+    u16 word = tx->pending;
+    tx->pending = 0;
+    return word;
+  }
+  switch (tx->phase) {
+    case LINK_BULK_TX_BEGIN:
+      tx->count = lc_bulk_chunk_words(tx->len, tx->chunk);
+      tx->pos = 0;
+      tx->crc = LINK_CRC16_INIT;
+      tx->nakked = false;
+      tx->tries++;
+      tx->phase = LINK_BULK_TX_LENGTH;
+      return LINK_CTRL(LINK_OP_BULK, tx->chunk & 0xF);
+    case LINK_BULK_TX_LENGTH:
+      tx->phase = LINK_BULK_TX_DATA;
+      return LINK_CRC16_WORD(tx->count);
+    case LINK_BULK_TX_DATA: {
+      u16 word = lc_bulk_read(tx);
+      tx->crc = lc_crc16_update(tx->crc, word);
+      if (++tx->pos == tx->count) {
+        tx->phase = LINK_BULK_TX_CRC_HIGH;
+      }
+      word ^= LINK_BULK_WHITEN;
+      if (word == LINK_NO_DATA || word >= LINK_CTRL_BASE) {
+        tx->pending = word ^ LINK_ESCAPE_MASK;
+        return LINK_CTRL_ESCAPE;
+      }
+      return word;
+    }
+    case LINK_BULK_TX_CRC_HIGH:
+      tx->phase = LINK_BULK_TX_CRC_LOW;
+      return LINK_CRC16_WORD(tx->crc >> 8);
+    default:
+      tx->phase = LINK_BULK_TX_WAIT;
+      tx->wait = 0;
+      return LINK_CRC16_WORD(tx->crc & 0xFF);
+  }
+}
+
+static inline void lc_bulk_retry(LinkConnection *self) {
+  LinkBulk *tx = &self->bulk_tx;
+  if (tx->tries >= LINK_BULK_MAX_TRIES) {
+    tx->status = LINK_BULK_FAILED;
+    return;
+  }
+  tx->phase = LINK_BULK_TX_BEGIN;
+  self->bulk_resent++;
+}
+
+// Called after every transfer.
+static inline void lc_bulk_on_transfer(LinkConnection *self) {
+  LinkBulk *tx = &self->bulk_tx;
+  if (tx->status != LINK_BULK_ACTIVE || tx->phase != LINK_BULK_TX_WAIT) {
+    return;
+  }
+  if (tx->nakked) {
+    lc_bulk_retry(self);
+    return;
+  }
+  // Players that left don't count.
+  u8 players = lc_bulk_players(self);
+  tx->waiting &= players;
+  if (tx->waiting == 0 && players != 0) {
+    tx->chunk++;
+    tx->tries = 0;
+    tx->waiting = 0xFF;
+    if (tx->chunk == lc_bulk_chunks(tx->len)) {
+      tx->status = LINK_BULK_DONE;
+    } else {
+      tx->phase = LINK_BULK_TX_BEGIN;
+    }
+  } else if (++tx->wait >= LINK_BULK_TIMEOUT) {
+    lc_bulk_retry(self);
+  }
+}
+
+static inline void lc_bulk_on_reply(LinkConnection *self, u8 player, u16 word) {
+  LinkBulk *tx = &self->bulk_tx;
+  u8 arg = LINK_CTRL_ARG(word);
+  if ((arg >> 2) != self->state.current_player_id || tx->status != LINK_BULK_ACTIVE ||
+      (arg & 1) != (tx->chunk & 1)) {
+    return;
+  }
+  if (!(tx->waiting & (1 << player))) {
+    return;
+  }
+  if (!(arg & 0b10)) {
+    tx->waiting &= ~(1 << player);
+    tx->tries = 0;
+  } else if (tx->phase == LINK_BULK_TX_WAIT) {
+    lc_bulk_retry(self);
+  } else if (tx->phase >= LINK_BULK_TX_DATA) {
+    // Too late to be about the previous send: resend once this one is out.
+    tx->nakked = true;
+  }
+}
+
+static inline void lc_bulk_reply(LinkConnection *self, u8 player, bool nak) {
+  lc_push_control(self, LINK_CTRL(LINK_OP_BULK_REPLY, (player << 2) | (nak << 1) | (self->bulk_rx[player].current & 1)));
+}
+
+static inline void lc_bulk_reject(LinkConnection *self, u8 player) {
+  LinkBulk *rx = &self->bulk_rx[player];
+  if (!rx->nakked && rx->status == LINK_BULK_ACTIVE) {
+    lc_bulk_reply(self, player, true);
+    self->bulk_nakked++;
+  }
+  rx->nakked = true;
+}
+
+static inline void lc_bulk_abort(LinkConnection *self, u8 player) {
+  lc_bulk_reject(self, player);
+  self->bulk_rx[player].phase = LINK_BULK_RX_NONE;
+}
+
+static inline void lc_bulk_on_begin(LinkConnection *self, u8 player, u16 word) {
+  LinkBulk *rx = &self->bulk_rx[player];
+  // If a chunk was cut short, the sender restarted: it already knows.
+  // Rebuild the full chunk number from its tag: the closest one to the expected chunk.
+  rx->current = rx->chunk + ((LINK_CTRL_ARG(word) - rx->chunk + 8) & 0xF) - 8;
+  rx->phase = LINK_BULK_RX_LENGTH;
+  rx->crc = LINK_CRC16_INIT;
+  rx->pos = 0;
+  rx->escaped = false;
+  rx->nakked = false;
+  rx->seen = true;
+}
+
+static inline void lc_bulk_on_chunk(LinkConnection *self, u8 player) {
+  LinkBulk *rx = &self->bulk_rx[player];
+  if (rx->status == LINK_BULK_IDLE || rx->status == LINK_BULK_FAILED) {
+    return;
+  }
+  if (rx->current + 1 == rx->chunk) {
+    // Our reply got lost: the sender is still waiting for it.
+    lc_bulk_reply(self, player, false);
+    return;
+  }
+  if (rx->current != rx->chunk || rx->status != LINK_BULK_ACTIVE) {
+    return;
+  }
+  if (rx->chunk == 0) {
+    u32 len = rx->length[0] | (rx->length[1] << 16);
+    if (len == 0 || len > rx->cap) {
+      rx->status = LINK_BULK_FAILED;
+      return;
+    }
+    rx->len = len;
+  }
+  lc_bulk_reply(self, player, false);
+  if (++rx->chunk == lc_bulk_chunks(rx->len)) {
+    rx->status = LINK_BULK_DONE;
+  }
+}
+
+// Chunk words from `player` (out-of-band words never get here).
+static inline void lc_bulk_on_word(LinkConnection *self, u8 player, u16 data) {
+  LinkBulk *rx = &self->bulk_rx[player];
+  bool store = rx->status == LINK_BULK_ACTIVE && rx->current == rx->chunk;
+  switch (rx->phase) {
+    case LINK_BULK_RX_LOST:
+      // No chunk is longer than that: anything after it is a message again.
+      if (++rx->pos >= LINK_BULK_CHUNK * 2 + 4) {
+        rx->phase = LINK_BULK_RX_NONE;
+      }
+      return;
+    case LINK_BULK_RX_LENGTH:
+      rx->count = data & 0xFF;
+      if ((data >> 8) != 1 || rx->count == 0 || rx->count > LINK_BULK_CHUNK ||
+          (store && rx->count != lc_bulk_chunk_words(rx->len, rx->chunk))) {
+        lc_bulk_abort(self, player);
+#ifndef LINK_ENABLE_RELIABLE
+        // Probably the length word was lost: the rest of the chunk follows.
+        rx->phase = LINK_BULK_RX_LOST;
+        rx->pos = 0;
+#endif
+        return;
+      }
+      rx->phase = LINK_BULK_RX_DATA;
+      return;
+    case LINK_BULK_RX_DATA:
+      if (rx->escaped) {
+        rx->escaped = false;
+        data ^= LINK_ESCAPE_MASK;
+      } else if (data == LINK_CTRL_ESCAPE) {
+        rx->escaped = true;
+        return;
+      }
+      data ^= LINK_BULK_WHITEN;
+      rx->crc = lc_crc16_update(rx->crc, data);
+      if (store) {
+        lc_bulk_write(rx, data);
+      }
+      if (++rx->pos == rx->count) {
+        rx->phase = LINK_BULK_RX_CRC_HIGH;
+      }
+      return;
+    case LINK_BULK_RX_CRC_HIGH:
+      if (data != LINK_CRC16_WORD(rx->crc >> 8)) {
+        lc_bulk_abort(self, player);
+        return;
+      }
+      rx->phase = LINK_BULK_RX_CRC_LOW;
+      return;
+    default:
+      if (data != LINK_CRC16_WORD(rx->crc & 0xFF)) {
+        lc_bulk_abort(self, player);
+        return;
+      }
+      rx->phase = LINK_BULK_RX_NONE;
+      lc_bulk_on_chunk(self, player);
+  }
+}
+
+// The failed transfer lost a word of every chunk being received. Parsing goes on (at
+// worst it ends one word late), so the rest of the chunk isn't taken for messages.
+// If the lost word was a chunk start, the chunk is discarded instead (reliable delivery
+// already drops words until the next retransmission).
+static inline void lc_bulk_on_error(LinkConnection *self) {
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    LinkBulk *rx = &self->bulk_rx[i];
+    if (rx->phase == LINK_BULK_RX_LOST) {
+      rx->pos = 0;
+    } else if (rx->phase != LINK_BULK_RX_NONE) {
+      lc_bulk_reject(self, i);
+#ifndef LINK_ENABLE_RELIABLE
+    } else if (rx->seen || rx->status == LINK_BULK_ACTIVE) {
+      rx->phase = LINK_BULK_RX_LOST;
+      rx->pos = 0;
+#endif
+    }
+  }
+}
+
+// Chunks are sent back to back, so an idle player isn't in the middle of one.
+static inline void lc_bulk_on_idle(LinkConnection *self, u8 player) {
+  if (self->bulk_rx[player].phase == LINK_BULK_RX_LOST) {
+    self->bulk_rx[player].phase = LINK_BULK_RX_NONE;
+  }
+}
+#endif
+
+// Desync checksums (internal)
+// ---------------------------
+// Every `check_every` frames, the folded checksum of the window goes out of band as
+// CHECK(LINK_CHECK_START | window & 7), then LINK_CHECKSUM_DIGITS CHECK words with 3 bits
+// of LINK_CHECKSUM_WORD(fold) each, most significant first. Every word is a control word,
+// so a lost one never reaches the incoming queues: the checksum is just incomplete.
+
+#ifdef LINK_ENABLE_CHECKSUM
+static inline void lc_checksum_compare(LinkConnection *self, u8 player, u32 window) {
+  u32 slot = window & (LINK_CHECKSUM_WINDOWS - 1);
+  if (window >= self->check_window || self->check_remote_window[player][slot] != window + 1) {
+    return;
+  }
+  self->checks++;
+  u32 window_start = window * self->check_every;
+  if (self->check_remote[player][slot] != self->check_local[slot] &&
+      (self->desync_window_start[player] == LINK_CHECKSUM_NONE || window_start < self->desync_window_start[player])) {
+    self->desync_window_start[player] = window_start;
+  }
+}
+
+static inline void lc_checksum_on_control(LinkConnection *self, u8 player, u16 word) {
+  u8 arg = LINK_CTRL_ARG(word);
+  if (arg & LINK_CHECK_START) {
+    self->check_tag[player] = arg & (LINK_CHECKSUM_WINDOWS - 1);
+    self->check_value[player] = 0;
+    self->check_digits[player] = 0;
+    return;
+  }
+  if (self->check_tag[player] < 0) {
+    return;
+  }
+  self->check_value[player] = (self->check_value[player] << 3) | arg;
+  if (++self->check_digits[player] < LINK_CHECKSUM_DIGITS) {
+    return;
+  }
+
+  // Rebuild the full window number from its tag: the closest one to ours.
+  u32 window = self->check_window +
+               ((self->check_tag[player] - self->check_window + LINK_CHECKSUM_WINDOWS / 2) & (LINK_CHECKSUM_WINDOWS - 1)) -
+               LINK_CHECKSUM_WINDOWS / 2;
+  self->check_tag[player] = -1;
+  u32 slot = window & (LINK_CHECKSUM_WINDOWS - 1);
+  self->check_remote[player][slot] = self->check_value[player];
+  self->check_remote_window[player][slot] = window + 1;
+  lc_checksum_compare(self, player, window);
+}
+
+static inline void lc_checksum_on_error(LinkConnection *self) {
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->check_tag[i] = -1;
+  }
+}
+#endif
+
+// Rollback input feed (internal)
+// ------------------------------
+// `lc_rollback_submit` sends an INPUT word followed by the lockstep word, so receivers
+// with a session attached take exactly those out of the stream (other words with
+// LINK_LOCKSTEP_FLAG are normal messages). Without reliable delivery, a transfer error
+// could take the lockstep word and leave its INPUT behind, so it's forgotten.
+
+#ifdef LINK_ENABLE_ROLLBACK
+static inline void lc_rollback_on_error(LinkConnection *self) {
+#ifndef LINK_ENABLE_RELIABLE
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->state.rx_input[i] = false;
+  }
+#endif
+}
+
+static inline void lc_rollback_on_input(LinkRollback *self, u8 player, u16 word) {
+  u32 frame = self->confirmed[player];
+  u32 ahead = ((word >> LINK_LOCKSTEP_TAG_SHIFT) - frame) & LINK_LOCKSTEP_TAG_MASK;
+  if (ahead > LINK_LOCKSTEP_TAG_MASK / 2) {
+    self->dropped++;
+    return;
+  }
+
+  u16 *history = self->inputs[player];
+  u16 previous = frame > 0 ? history[(frame - 1) & (LINK_ROLLBACK_FRAMES - 1)] : 0;
+  for (u32 i = 0; i <= ahead; i++, frame++) {
+    // Skipped frames lost their input: assume it didn't change.
+    u16 input = i == ahead ? word & LINK_LOCKSTEP_INPUT_MASK : previous;
+    u16 *slot = &history[frame & (LINK_ROLLBACK_FRAMES - 1)];
+    if (frame < self->fetched && *slot != input && frame < self->rollback_from) {
+      self->rollback_from = frame;
+    }
+    *slot = input;
+  }
+  self->lost += ahead;
+  self->confirmed[player] = frame;
+}
+#endif
+
+static inline void lc_on_player_connected(LinkConnection *self, u8 player) {
+#ifdef LINK_ENABLE_RELIABLE
+  lc_reliable_on_connect(self, player);
+#endif
+#ifdef LINK_ENABLE_EVENTS
+  lc_events_push(self, LINK_EVENT_JOINED, player, 0);
+#endif
+}
+
+static inline void lc_on_player_disconnected(LinkConnection *self, u8 player) {
+#ifdef LINK_ENABLE_DELTA
+  self->held[player] = LINK_NO_DATA;
+#endif
+#ifdef LINK_ENABLE_BYTES
+  self->state.rx_bytes[player] = u8q_init(LINK_BYTES_BUFFER_LEN, self->state.rx_bytes_buffer[player]);
+  self->state.rx_run[player] = LINK_BYTES_NONE;
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+  for (u32 c = 0; c < LINK_CHANNELS - 1; c++) {
+    LINK_QUEUE_CLEAR(&self->state.channel_in[c][player]);
+  }
+  self->state.rx_channel[player] = 0;
+#endif
+#ifdef LINK_ENABLE_URGENT
+  self->state.rx_urgent[player] = false;
+#endif
+#ifdef LINK_ENABLE_EVENTS
+  lc_events_push(self, LINK_EVENT_LEFT, player, 0);
+#endif
+#ifdef LINK_ENABLE_CRC16
+  lc_packet_abort(self, player);
+#endif
+#ifdef LINK_ENABLE_BULK
+  self->bulk_rx[player].phase = LINK_BULK_RX_NONE;
+  self->bulk_rx[player].seen = false;
+  if (self->bulk_rx[player].status == LINK_BULK_ACTIVE) {
+    self->bulk_rx[player].status = LINK_BULK_FAILED;
+  }
+#endif
+#ifdef LINK_ENABLE_RELIABLE
+  lc_reliable_release(self);
+#endif
+}
+
+static inline void lc_on_player_idle(LinkConnection *self, u8 player) {
+#ifdef LINK_ENABLE_CRC16
+  lc_packet_on_idle(self, player);
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+  lc_channels_on_idle(self, player);
+#endif
+#ifdef LINK_ENABLE_URGENT
+  self->state.rx_urgent[player] = false;
+#endif
+#ifdef LINK_ENABLE_CHECKSUM
+  self->check_tag[player] = -1;
+#endif
+#ifdef LINK_ENABLE_BULK
+  lc_bulk_on_idle(self, player);
+#endif
+#ifdef LINK_ENABLE_RELIABLE
+  if (self->state.rx_unacked[player] > 0) {
+    lc_reliable_schedule_ack(self, player);
+  }
+#endif
+}
+
+static inline void lc_receive(LinkConnection *self, u8 player, u16 data) {
+#ifdef LINK_ENABLE_URGENT
+  if (lc_urgent_on_word(self, player, data)) {
+    return;
+  }
+#endif
+#ifdef LINK_ENABLE_BULK
+  if (self->bulk_rx[player].phase != LINK_BULK_RX_NONE && !(data >= LINK_CTRL_BASE && data < LINK_CTRL_STREAM_BASE)) {
+    lc_bulk_on_word(self, player, data);
+    return;
+  }
+#endif
+#ifdef LINK_ENABLE_CONTROL
+  if (data >= LINK_CTRL_BASE && data < LINK_CTRL_STREAM_BASE) {
+#ifdef LINK_ENABLE_RELIABLE
+    if (LINK_CTRL_OP(data) <= LINK_OP_REQ) {
+      lc_reliable_on_control(self, player, data);
+    }
+#endif
+#ifdef LINK_ENABLE_PING
+    if (LINK_CTRL_OP(data) == LINK_OP_PONG) {
+      lc_ping_on_pong(self, player, data);
+    }
+#endif
+#ifdef LINK_ENABLE_CHECKSUM
+    if (LINK_CTRL_OP(data) == LINK_OP_CHECK) {
+      lc_checksum_on_control(self, player, data);
+    }
+#endif
+#ifdef LINK_ENABLE_BULK
+    if (LINK_CTRL_OP(data) == LINK_OP_BULK) {
+      lc_bulk_on_begin(self, player, data);
+    } else if (LINK_CTRL_OP(data) == LINK_OP_BULK_REPLY) {
+      lc_bulk_on_reply(self, player, data);
+    }
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+    lc_channels_on_control(self, player, data);
+#endif
+#ifdef LINK_ENABLE_AUTO_BAUD
+    if (data == LINK_CTRL(LINK_OP_SYNC, LINK_SYNC_SLOWER)) {
+      self->baud_slower = true;
+    } else if (player == 0 && data >= LINK_CTRL(LINK_OP_SYNC, LINK_SYNC_BAUD) &&
+               data <= LINK_CTRL(LINK_OP_SYNC, LINK_SYNC_BAUD + BAUD_RATE_3)) {
+      self->baud_next = LINK_CTRL_ARG(data) - LINK_SYNC_BAUD;
+      self->baud_switch = true;
+    }
+#endif
+    return;
+  }
+#endif
+#ifdef LINK_ENABLE_RELIABLE
+  if (!lc_reliable_accept(self, player)) {
+    return;
+  }
+#endif
+#ifdef LINK_ENABLE_CONTROL
+  if (self->state.rx_escaped[player]) {
+    self->state.rx_escaped[player] = false;
+    data ^= LINK_ESCAPE_MASK;
+  } else if (data == LINK_CTRL_ESCAPE) {
+    self->state.rx_escaped[player] = true;
+    return;
+  } else if (data >= LINK_CTRL_BASE) {
+#ifdef LINK_ENABLE_CRC16
+    lc_packet_on_control(self, player, data);
+#endif
+#ifdef LINK_ENABLE_BYTES
+    lc_bytes_on_control(self, player, data);
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+    lc_channels_on_control(self, player, data);
+#endif
+#ifdef LINK_ENABLE_PING
+    if (LINK_CTRL_OP(data) == LINK_OP_PING) {
+      lc_push_control(self, LINK_CTRL(LINK_OP_PONG, (player << 2) | LINK_CTRL_ARG(data)));
+    }
+#endif
+#ifdef LINK_ENABLE_ROLLBACK
+    self->state.rx_input[player] = LINK_CTRL_OP(data) == LINK_OP_INPUT;
+#endif
+    return;
+  }
+#endif
+#ifdef LINK_ENABLE_ROLLBACK
+  if (self->state.rx_input[player]) {
+    self->state.rx_input[player] = false;
+    if (self->rollback && (data & LINK_LOCKSTEP_FLAG)) {
+      lc_rollback_on_input(self->rollback, player, data);
+      return;
+    }
+  }
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+  if (lc_channels_on_word(self, player, data)) {
+    return;
+  }
+#endif
+#ifdef LINK_ENABLE_BYTES
+  if (lc_bytes_on_word(self, player, data)) {
+    return;
+  }
+#endif
+#ifdef LINK_ENABLE_CRC16
+  if (lc_packet_on_word(self, player, data)) {
+    return;
+  }
+#endif
+#ifdef LINK_ENABLE_DELTA
+#ifdef LINK_ENABLE_CRC16
+  if (self->state.rx_packet[player] == LINK_PACKET_NONE)
+#endif
+  if (data != self->held[player]) {
+    self->held[player] = data;
+    self->held_since[player] = self->frame;
+  }
+#endif
+  U16Queue *q = &self->state.incoming_messages[player];
+  lc_push(self, q, data);
+  LINK_STAT_MAX(self, incoming_high_water[player], q->len);
+}
+
+static inline bool lc_queue_message(LinkConnection *self, u16 data) {
+  U16Queue *q = &self->state.outgoing_messages;
+#ifdef LINK_ENABLE_CONTROL
+  u32 needed = data >= LINK_CTRL_BASE ? 2 : 1;
+#ifdef LINK_ENABLE_CHANNELS
+  needed += lc_channels_tag_len(self, 0);
+#endif
+  if (q->len + needed > self->buffer_len) {
+    LINK_STAT_ADD(self, queue_overflows);
+    return false;
+  }
+#ifdef LINK_ENABLE_CHANNELS
+  lc_channels_tag(self, 0);
+#endif
+  if (data >= LINK_CTRL_BASE) {
+    u16q_push(q, LINK_CTRL_ESCAPE);
+    data ^= LINK_ESCAPE_MASK;
+  }
+  u16q_push(q, data);
+#else
+  lc_push(self, q, data);
+#endif
+  LINK_STAT_MAX(self, outgoing_high_water, q->len);
+  return true;
+}
+
+static inline void lc_transfer(LinkConnection *self, u16 data) {
+  REG_SIOMLT_SEND = data;
+#ifdef LINK_ENABLE_STATS
+  if (data != LINK_NO_DATA) {
+    self->stats.words_sent++;
+  }
+#endif
+
+  if (lc_is_master(self))
+    setBitHigh(LINK_BIT_START);
+}
+
+static inline u16 lc_next_message(LinkConnection *self) {
+#ifdef LINK_ENABLE_RELIABLE
+  return lc_reliable_next(self);
+#else
+  return LINK_QUEUE_POP(&self->state.outgoing_messages);
+#endif
+}
+
+static inline void lc_send_pending_data(LinkConnection *self) {
+#ifdef LINK_ENABLE_URGENT
+  lc_urgent_on_sent(self);
+  // Nothing goes between an URGENT word and its message.
+  if (self->state.tx_urgent == LINK_URGENT_WORD) {
+    lc_transfer(self, lc_urgent_next(self));
+    return;
+  }
+#endif
+#ifdef LINK_ENABLE_CONTROL
+  if (!u16q_empty(&self->state.control_messages)) {
+#ifdef LINK_ENABLE_RELIABLE
+    u16 control = lc_reliable_next_control(self);
+#else
+    u16 control = LINK_QUEUE_POP(&self->state.control_messages);
+#endif
+#ifdef LINK_ENABLE_AUTO_BAUD
+    if (lc_is_master(self) && self->baud_next != LINK_BAUD_NONE) {
+      self->baud_switch = control == LINK_CTRL(LINK_OP_SYNC, LINK_SYNC_BAUD + self->baud_next);
+    }
+#endif
+    lc_transfer(self, control);
+    return;
+  }
+#endif
+#ifdef LINK_ENABLE_BULK
+  if (lc_bulk_is_sending(self)) {
+    lc_transfer(self, lc_bulk_next(self));
+    return;
+  }
+#endif
+#ifdef LINK_ENABLE_URGENT
+  if (!u16q_empty(&self->state.urgent_messages)) {
+    lc_transfer(self, lc_urgent_next(self));
+    return;
+  }
+#endif
+  u16 data = lc_next_message(self);
+#ifdef LINK_ENABLE_BYTES
+  // Waiting bytes go out as soon as there's nothing else to send.
+  if (data == LINK_NO_DATA && self->state.tx_bytes.len > 0) {
+    lc_bytes_flush(self);
+    data = lc_next_message(self);
+  }
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+  if (data == LINK_NO_DATA && lc_channels_feed(self)) {
+    data = lc_next_message(self);
+  }
+#endif
+#ifdef LINK_ENABLE_BULK
+  // Chunks only start when there are no messages to send.
+  if (data == LINK_NO_DATA && lc_bulk_can_start(self)) {
+    data = lc_bulk_next(self);
+  }
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+  if (data == LINK_NO_DATA) {
+    lc_channels_on_idle_sent(self);
+  }
+#endif
+  lc_transfer(self, data);
+}
+
+static inline void lc_on_timer(LinkConnection *self);
+static inline void lc_on_scheduler_tick(void *context) {
+  lc_on_timer((LinkConnection *)context);
+}
+
+static inline void lc_stop_timer(LinkConnection *self) {
+  if (self->scheduler) {
+    lc_scheduler_remove(self->scheduler, self->timer_slot);
+    self->timer_slot = -1;
+    return;
+  }
+  REG_TM[self->send_timer_id].cnt = REG_TM[self->send_timer_id].cnt & (~TM_ENABLE);
+}
+
+static inline void lc_start_timer(LinkConnection *self) {
+  if (self->scheduler) {
+    lc_scheduler_remove(self->scheduler, self->timer_slot);
+    self->timer_slot = lc_scheduler_add(self->scheduler, self->interval, lc_on_scheduler_tick, self);
+    return;
+  }
+  REG_TM[self->send_timer_id].start = -(self->interval);
+  REG_TM[self->send_timer_id].cnt = TM_ENABLE | TM_IRQ | LINK_BASE_FREQUENCY;
+}
+
+static inline void lc_stop(LinkConnection *self) {
+  lc_stop_timer(self);
+
+  LINK_SET_LOW(REG_RCNT, LINK_BIT_GENERAL_PURPOSE_LOW);
+  LINK_SET_HIGH(REG_RCNT, LINK_BIT_GENERAL_PURPOSE_HIGH);
+}
+
+static inline void lc_start(LinkConnection *self) {
+  lc_start_timer(self);
+
+  LINK_SET_LOW(REG_RCNT, LINK_BIT_GENERAL_PURPOSE_HIGH);
+  REG_SIOCNT = self->baud_rate;
+  REG_SIOMLT_SEND = 0;
+  setBitHigh(LINK_BIT_MULTIPLAYER);
+  setBitHigh(LINK_BIT_IRQ);
+}
+
+#ifdef LINK_ENABLE_BULK
+// Runs the send timer at the LINK_BULK_INTERVALS pace while a transfer is active.
+static inline void lc_bulk_pace(LinkConnection *self, bool fast) {
+  static const u16 intervals[] = LINK_BULK_INTERVALS;
+  if (fast == self->bulk_fast) {
+    return;
+  }
+  self->bulk_fast = fast;
+  if (fast) {
+    self->bulk_interval = self->interval;
+    if (intervals[self->baud_rate] >= self->interval) {
+      return;
+    }
+    self->interval = intervals[self->baud_rate];
+  } else {
+    self->interval = self->bulk_interval;
+  }
+  if (self->is_enabled) {
+    lc_start_timer(self);
+  }
+}
+#endif
+
+
+// Baud rate negotiation (internal)
+// --------------------------------
+// Every console starts at BAUD_RATE_0 after a reset. The errors of each window of
+// LINK_BAUD_WINDOW transfers (failed transfers and CRC failures) are counted: once they
+// reach LINK_BAUD_DOWN_ERRORS the master steps down a rate (a slave sends it a
+// SYNC(LINK_SYNC_SLOWER) instead), and after enough clean windows it tries the next one,
+// up to `baud_max`. Each step down from a rate doubles the clean windows it needs the
+// next time. The master announces a rate with SYNC(LINK_SYNC_BAUD + rate), and every
+// console switches to it at the end of the good transfer that carried it. A console that
+// missed it keeps the old rate, so the others get LINK_BAUD_FALLBACK_ERRORS failed
+// transfers in a row before any works at the new one, and go back to the previous rate.
+
+#ifdef LINK_ENABLE_AUTO_BAUD
+static inline void lc_baud_window_start(LinkConnection *self) {
+  self->baud_transfers = self->baud_errors = 0;
+  self->baud_slower = false;
+}
+
+static inline void lc_baud_set(LinkConnection *self, u8 rate) {
+  self->baud_rate = rate;
+  self->baud_next = self->baud_previous = LINK_BAUD_NONE;
+  self->baud_switch = false;
+  self->baud_clean = 0;
+  lc_baud_window_start(self);
+  REG_SIOCNT = (REG_SIOCNT & ~0b11) | rate;
+#ifdef LINK_ENABLE_BULK
+  if (self->bulk_fast) {
+    // Back to the bulk pace of the new rate.
+    lc_bulk_pace(self, false);
+    lc_bulk_pace(self, true);
+  }
+#endif
+}
+
+static inline void lc_baud_switch(LinkConnection *self, u8 rate) {
+  u8 previous = self->baud_rate;
+  lc_baud_set(self, rate);
+  self->baud_previous = previous;
+#ifdef LINK_ENABLE_EVENTS
+  lc_events_push(self, LINK_EVENT_BAUD, 0, rate);
+#endif
+}
+
+static inline void lc_baud_announce(LinkConnection *self, u8 rate) {
+  U16Queue *control = &self->state.control_messages;
+  if (self->baud_next != LINK_BAUD_NONE || control->len == LINK_CONTROL_BUFFER_LEN) {
+    return;
+  }
+  self->baud_next = rate;
+  u16q_push(control, LINK_CTRL(LINK_OP_SYNC, LINK_SYNC_BAUD + rate));
+}
+
+static inline void lc_baud_strike(LinkConnection *self) {
+  if (self->baud_rate != BAUD_RATE_0 && self->baud_strikes[self->baud_rate] < LINK_BAUD_MAX_BACKOFF) {
+    self->baud_strikes[self->baud_rate]++;
+  }
+}
+
+static inline void lc_baud_add_errors(LinkConnection *self, u32 errors) {
+  self->baud_errors += errors;
+  if (self->baud_errors < LINK_BAUD_DOWN_ERRORS) {
+    return;
+  }
+  lc_baud_window_start(self);
+  self->baud_clean = 0;
+  if (!lc_is_master(self)) {
+    lc_push_control(self, LINK_CTRL(LINK_OP_SYNC, LINK_SYNC_SLOWER));
+  } else if (self->baud_rate != BAUD_RATE_0) {
+    lc_baud_strike(self);
+    lc_baud_announce(self, self->baud_rate - 1);
+  }
+}
+
+// Called after every failed transfer, with `failures` up to date.
+static inline void lc_baud_on_error(LinkConnection *self) {
+  if (self->baud_switch) {
+    // Whoever got the announcement falls back on its own: the master can announce again.
+    self->baud_switch = false;
+    self->baud_next = LINK_BAUD_NONE;
+  }
+  if (self->baud_previous != LINK_BAUD_NONE && self->state.failures >= LINK_BAUD_FALLBACK_ERRORS) {
+    lc_baud_strike(self);
+    lc_baud_switch(self, self->baud_previous);
+    self->baud_previous = LINK_BAUD_NONE;
+    self->state.failures = 0;
+    return;
+  }
+  lc_baud_add_errors(self, 1);
+}
+
+// Called after every good transfer, with `player_count` up to date.
+static inline void lc_baud_on_transfer(LinkConnection *self) {
+  if (self->baud_switch) {
+    lc_baud_switch(self, self->baud_next);
+    return;
+  }
+  self->baud_previous = LINK_BAUD_NONE;
+
+  u32 crc_errors = 0;
+#ifdef LINK_ENABLE_CRC16
+  crc_errors += self->packets_dropped;
+#endif
+#ifdef LINK_ENABLE_BULK
+  crc_errors += self->bulk_nakked;
+#endif
+  lc_baud_add_errors(self, crc_errors - self->baud_crc_errors);
+  self->baud_crc_errors = crc_errors;
+  if (self->baud_slower && lc_is_master(self)) {
+    lc_baud_add_errors(self, LINK_BAUD_DOWN_ERRORS);
+    return;
+  }
+
+  if (++self->baud_transfers < LINK_BAUD_WINDOW) {
+    return;
+  }
+  bool is_clean = self->baud_errors <= LINK_BAUD_UP_ERRORS;
+  lc_baud_window_start(self);
+  if (!is_clean || self->state.player_count < 2) {
+    self->baud_clean = 0;
+    return;
+  }
+  if (self->baud_clean < 0xFF) {
+    self->baud_clean++;
+  }
+  u8 next = self->baud_rate + 1;
+  if (lc_is_master(self) && next <= self->baud_max && self->baud_clean >= 1 << self->baud_strikes[next]) {
+    lc_baud_announce(self, next);
+  }
+}
+#endif
+
+static inline void lc_trace(LinkConnection *self, u8 type) {
+#ifdef LINK_ENABLE_TRACE
+  if (self->trace_paused) {
+    return;
+  }
+  LinkTraceEvent *event = &self->trace[self->trace_next++ & (LINK_TRACE_LEN - 1)];
+  event->time = lc_clock_now();
+  event->siocnt = REG_SIOCNT;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    event->data[i] = REG_SIOMULTI[i];
+    event->incoming_len[i] = self->state.incoming_messages[i].len;
+  }
+  event->type = type;
+  event->outgoing_len = self->state.outgoing_messages.len;
+#endif
+}
+
+static inline u16 lc_features(void) {
+  u16 features = 0;
+#ifdef LINK_ENABLE_RELIABLE
+  features |= LINK_FEATURE_RELIABLE;
+#endif
+#ifdef LINK_ENABLE_PING
+  features |= LINK_FEATURE_PING;
+#endif
+#ifdef LINK_ENABLE_CHECKSUM
+  features |= LINK_FEATURE_CHECKSUM;
+#endif
+#ifdef LINK_ENABLE_CRC16
+  features |= LINK_FEATURE_CRC16;
+#endif
+#ifdef LINK_ENABLE_BULK
+  features |= LINK_FEATURE_BULK;
+#endif
+#ifdef LINK_ENABLE_BYTES
+  features |= LINK_FEATURE_BYTES;
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+  features |= LINK_FEATURE_CHANNELS;
+#endif
+#ifdef LINK_ENABLE_URGENT
+  features |= LINK_FEATURE_URGENT;
+#endif
+#ifdef LINK_ENABLE_TIMEOUT_US
+  features |= LINK_FEATURE_TIMEOUT_US;
+#endif
+#ifdef LINK_ENABLE_AUTO_BAUD
+  features |= LINK_FEATURE_AUTO_BAUD;
+#endif
+#ifdef LINK_ENABLE_ROLLBACK
+  features |= LINK_FEATURE_ROLLBACK;
+#endif
+#ifdef LINK_ENABLE_CALLBACKS
+  features |= LINK_FEATURE_CALLBACKS;
+#endif
+#ifdef LINK_ENABLE_DELTA
+  features |= LINK_FEATURE_DELTA;
+#endif
+  return features;
+}
+
+#ifdef LINK_ENABLE_RECORD
+typedef struct LinkRecordIrq {
+  u32 start;
+  u16 siocnt;
+  u16 data[LINK_MAX_PLAYERS];
+  u8 type;
+  bool was_locked;
+} LinkRecordIrq;
+
+static inline u32 lc_record_varint(u8 *out, u32 value) {
+  u32 len = 0;
+  while (value >= 0x80) {
+    out[len++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[len++] = value;
+  return len;
+}
+
+static inline u32 lc_record_u16(u8 *out, u16 value) {
+  out[0] = value & 0xFF;
+  out[1] = value >> 8;
+  return 2;
+}
+
+// Must run with IRQs disabled: records are appended in the order they're encoded.
+static inline void lc_record_append(LinkConnection *self, const u8 *record, u32 len) {
+  if (self->record_len + len > self->record_cap) {
+    self->is_recording = false;
+    return;
+  }
+  for (u32 i = 0; i < len; i++) {
+    self->record_buf[self->record_len++] = record[i];
+  }
+}
+
+static inline LinkRecordIrq lc_record_irq_begin(LinkConnection *self, u8 type) {
+  LinkRecordIrq irq = {
+    .start = lc_clock_now(),
+    .siocnt = REG_SIOCNT,
+    .type = type,
+    .was_locked = self->state.is_locked,
+  };
+  if (type == LINK_RECORD_SERIAL) {
+    for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+      irq.data[i] = REG_SIOMULTI[i];
+    }
+  }
+  return irq;
+}
+
+static inline void lc_record_irq_end(LinkConnection *self, LinkRecordIrq *irq) {
+  u32 cycles = lc_clock_now() - irq->start;
+  u8 record[LINK_RECORD_MAX_SIZE];
+  u16 ime = REG_IME;
+  REG_IME = 0;
+
+  if (self->is_recording) {
+    u8 head = irq->type | (irq->was_locked << 2);
+    u32 len = 1;
+    len += lc_record_varint(record + len, irq->start - self->record_time);
+    len += lc_record_varint(record + len, cycles);
+    if (irq->type != LINK_RECORD_VBLANK && irq->siocnt != self->record_siocnt) {
+      head |= 1 << 3;
+      len += lc_record_u16(record + len, irq->siocnt);
+      self->record_siocnt = irq->siocnt;
+    }
+    if (irq->type == LINK_RECORD_SERIAL) {
+      for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+        if (irq->data[i] != self->record_data[i]) {
+          head |= 1 << (4 + i);
+          len += lc_record_u16(record + len, irq->data[i]);
+          self->record_data[i] = irq->data[i];
+        }
+      }
+    }
+    record[0] = head;
+    self->record_time = irq->start;
+    lc_record_append(self, record, len);
+  }
 
-static inline void lc_transfer(LinkConnection *self, u16 data) {
-  REG_SIOMLT_SEND = data;
+  REG_IME = ime;
+}
+#endif
 
-  if (lc_is_master(self))
-    setBitHigh(LINK_BIT_START);
+static inline void lc_record_call(LinkConnection *self, bool is_read, u8 player_id, u16 data) {
+#ifdef LINK_ENABLE_RECORD
+  u32 time = lc_clock_now();
+  u8 record[LINK_RECORD_MAX_SIZE];
+  u16 ime = REG_IME;
+  REG_IME = 0;
+
+  if (self->is_recording) {
+    u32 len = 1;
+    record[0] = LINK_RECORD_CALL | (is_read << 2) | ((player_id & 0b11) << 4);
+    len += lc_record_varint(record + len, time - self->record_time);
+    if (!is_read) {
+      len += lc_record_u16(record + len, data);
+    }
+    self->record_time = time;
+    lc_record_append(self, record, len);
+  }
+
+  REG_IME = ime;
+#endif
+}
+
+static inline void lc_record_other(LinkConnection *self, u8 call, u8 player_id, u32 a, u32 b, const void *payload) {
+#ifdef LINK_ENABLE_RECORD
+  u32 time = lc_clock_now();
+  u8 record[LINK_RECORD_MAX_SIZE];
+  u32 payload_len = call == LINK_RECORD_CALL_PACKET ? a * 2 : call == LINK_RECORD_CALL_WRITE ? a : 0;
+  u16 ime = REG_IME;
+  REG_IME = 0;
+
+  if (self->is_recording) {
+    u32 len = 1;
+    record[0] = LINK_RECORD_CALL | (1 << 3) | ((player_id & 0b11) << 4);
+    len += lc_record_varint(record + len, time - self->record_time);
+    record[len++] = call;
+    len += lc_record_varint(record + len, a);
+    len += lc_record_varint(record + len, b);
+    // The payload is appended in pieces, so check that the whole record fits first.
+    if (self->record_len + len + payload_len > self->record_cap) {
+      self->is_recording = false;
+    } else {
+      self->record_time = time;
+      lc_record_append(self, record, len);
+      if (call == LINK_RECORD_CALL_PACKET) {
+        for (u32 i = 0; i < a; i++) {
+          lc_record_append(self, record, lc_record_u16(record, ((const u16 *)payload)[i]));
+        }
+      } else if (call == LINK_RECORD_CALL_WRITE) {
+        lc_record_append(self, payload, a);
+      }
+    }
+  }
+
+  REG_IME = ime;
+#endif
+}
+
+static inline void lc_reset(LinkConnection *self) {
+  lc_trace(self, LINK_EVENT_RESET);
+  lc_reset_state(self);
+#ifdef LINK_ENABLE_AUTO_BAUD
+  // Consoles that reset at different times meet again at the slowest rate.
+  lc_baud_set(self, BAUD_RATE_0);
+#endif
+  lc_stop(self);
+  lc_start(self);
+#ifdef LINK_ENABLE_SNAPSHOT
+  lc_publish(self);
+#endif
+}
+
+// Re-arms SIOCNT and the send timer, keeping every queued message.
+static inline void lc_soft_reset(LinkConnection *self) {
+#ifdef LINK_ENABLE_RELIABLE
+  lc_reliable_on_error(self);
+#endif
+  lc_stop(self);
+  lc_start(self);
+}
+
+static inline bool lc_reset_if_needed(LinkConnection *self) {
+  bool is_ready = lc_is_ready(self);
+  if (is_ready && !lc_has_error(self)) {
+    return false;
+  }
+  self->state.failures++;
+  LINK_STAT_ADD(self, transfer_errors);
+#ifdef LINK_ENABLE_AUTO_BAUD
+  lc_baud_on_error(self);
+#endif
+#ifdef LINK_ENABLE_CHECKSUM
+  lc_checksum_on_error(self);
+#endif
+#ifdef LINK_ENABLE_CRC16
+  lc_packet_on_error(self);
+#endif
+#ifdef LINK_ENABLE_BULK
+  lc_bulk_on_error(self);
+#endif
+#ifdef LINK_ENABLE_CHANNELS
+  lc_channels_on_error(self);
+#endif
+#ifdef LINK_ENABLE_URGENT
+  lc_urgent_on_error(self);
+#endif
+#ifdef LINK_ENABLE_ROLLBACK
+  lc_rollback_on_error(self);
+#endif
+  if (self->state.failures > self->soft_resets) {
+    LINK_STAT_ADD(self, resets_error);
+#ifdef LINK_ENABLE_AUTO_BAUD
+    lc_baud_strike(self);
+#endif
+    lc_reset(self);
+#ifdef LINK_ENABLE_EVENTS
+    lc_events_on_reset(self, LINK_RESET_ERROR);
+#endif
+    return true;
+  }
+  bool is_slave = !lc_is_master(self);
+#ifdef LINK_ENABLE_RELIABLE
+  if (is_ready) {
+    // Drop this transfer and ask for a retransmission instead of resetting.
+    lc_reliable_on_error(self);
+    if (is_slave) {
+      lc_send_pending_data(self);
+    }
+    return true;
+  }
+#endif
+  LINK_STAT_ADD(self, resets_soft);
+  lc_soft_reset(self);
+  // Reload the next word: receivers take a gap as the end of a chunk, packet or byte run.
+  if (is_slave) {
+    lc_send_pending_data(self);
+  }
+  return true;
+}
+
+
+// Public API
+// ----------
+
+/**
+ * Initialise a link connection, providing existing memory for the message queues.
+ * 
+ * Note: `buffer_mem` should point to a region of size (LINK_TOTAL_BUFFERS * buffer_len * sizeof(u16))
+ */
+static inline LinkConnection lc_init_manual(LinkConnectionSettings settings, u16 *buffer_mem) {
+  LinkConnection self = {
+    .state = linkstate_init(settings.buffer_len, buffer_mem),
+    .baud_rate = settings.baud_rate,
+    .timeout = settings.timeout,
+    .remote_timeout = settings.remote_timeout,
+    .soft_resets = settings.soft_resets,
+    .buffer_len = settings.buffer_len,
+    .interval = settings.interval,
+    .send_timer_id = settings.send_timer_id,
+    .scheduler = settings.scheduler,
+    .timer_slot = -1,
+  };
+#ifdef LINK_ENABLE_DELTA
+  self.delta_refresh = settings.delta_refresh;
+#endif
+#ifdef LINK_ENABLE_AUTO_BAUD
+  self.baud_max = settings.baud_rate;
+#endif
+#ifdef LINK_ENABLE_TIMEOUT_US
+  self.timeout_us = settings.timeout_us;
+  self.remote_timeout_us = settings.remote_timeout_us;
+  self.timeout_ticks = lc_clock_ticks(settings.timeout_us);
+  self.remote_timeout_ticks = lc_clock_ticks(settings.remote_timeout_us);
+#endif
+  u8 timer_id = settings.scheduler ? settings.scheduler->timer_id : settings.send_timer_id;
+  self.state.irq_mask = IRQ_SERIAL | (timer_id < 4 ? IRQ_TIMER0 << timer_id : 0);
+#ifdef LINK_ENABLE_CHANNELS
+  for (u32 c = 0; c < LINK_CHANNELS; c++) {
+    self.channel_weight[c] = 1;
+  }
+#endif
+  lc_stop(&self);
+  return self;
+}
+
+/**
+ * Initialise a link connection.
+ */
+static inline LinkConnection lc_init(LinkConnectionSettings settings) {
+  u16 *buffer_mem = malloc(LINK_TOTAL_BUFFERS * settings.buffer_len * sizeof(u16));
+  LinkConnection result = lc_init_manual(settings, buffer_mem);
+  result.buffer_mem = buffer_mem;
+  return result;
+}
+
+/**
+ * Close the link and deallocate the buffers (unless they were provided with `lc_init_manual`).
+ */
+static inline void lc_destroy(LinkConnection *self) {
+  lc_stop(self);
+#ifdef LINK_ENABLE_CLOCK
+  lc_clock_stop();
+#endif
+  if (self->buffer_mem) {
+    free(self->buffer_mem);
+  }
+}
+
+static inline bool lc_is_active(LinkConnection *self) {
+  return self->is_enabled;
+}
+
+/**
+ * The baud rate in use. With LINK_ENABLE_AUTO_BAUD it changes as the master steps it up
+ * or down, and goes back to BAUD_RATE_0 on every reset.
+ */
+static inline BaudRate lc_baud_rate(LinkConnection *self) {
+  return self->baud_rate;
+}
+
+static inline void lc_activate(LinkConnection *self) {
+#ifdef LINK_ENABLE_CLOCK
+  lc_clock_start();
+#endif
+#ifdef LINK_ENABLE_AUTO_BAUD
+  for (u32 i = 0; i < 4; i++) {
+    self->baud_strikes[i] = 0;
+  }
+#endif
+  lc_reset(self);
+  self->frame = 0;
+#ifdef LINK_ENABLE_EVENTS
+  self->event_next = self->event_count = 0;
+  self->event_role = self->event_player_id = 0xFF;
+#endif
+  self->is_enabled = true;
+}
+
+static inline void lc_deactivate(LinkConnection *self) {
+  self->is_enabled = false;
+  lc_reset_state(self);
+  lc_stop(self);
+#ifdef LINK_ENABLE_SNAPSHOT
+  lc_publish(self);
+#endif
+#ifdef LINK_ENABLE_CLOCK
+  lc_clock_stop();
+#endif
+}
+
+/**
+ * Queue a message for all the other players. Returns false if it was rejected
+ * (reserved value, or no room left when `LINK_ENABLE_CONTROL` is on).
+ */
+static inline bool lc_send(LinkConnection *self, u16 data) {
+  lc_record_call(self, false, 0, data);
+  if (data == LINK_DISCONNECTED || data == LINK_NO_DATA) {
+    LINK_STAT_ADD(self, send_rejects);
+    return false;
+  }
+  LINK_LOCK(&self->state);
+#ifdef LINK_ENABLE_DELTA
+  bool queued;
+  if (self->delta_refresh > 0 && data == self->delta_last && ++self->delta_skips < self->delta_refresh) {
+    LINK_STAT_ADD(self, sends_suppressed);
+    queued = true;
+  } else {
+    queued = lc_queue_message(self, data);
+    if (queued) {
+      self->delta_last = data;
+      self->delta_skips = 0;
+    }
+  }
+#else
+  bool queued = lc_queue_message(self, data);
+#endif
+  LINK_UNLOCK(&self->state);
+  return queued;
+}
+
+/**
+ * Queue `data` ahead of every message waiting in the outgoing queue: it goes out in
+ * two back-to-back transfers as soon as no out-of-band words are waiting, and arrives
+ * as a normal message. Returns false if it's a reserved value or LINK_URGENT_BUFFER_LEN messages
+ * are waiting already (always, without LINK_ENABLE_URGENT).
+ */
+static inline bool lc_send_urgent(LinkConnection *self, u16 data) {
+#ifdef LINK_ENABLE_URGENT
+  lc_record_other(self, LINK_RECORD_CALL_URGENT, 0, data, 0, NULL);
+  if (data == LINK_DISCONNECTED || data == LINK_NO_DATA) {
+    LINK_STAT_ADD(self, send_rejects);
+    return false;
+  }
+  U16Queue *q = &self->state.urgent_messages;
+  LINK_LOCK(&self->state);
+  bool fits = q->len < LINK_URGENT_BUFFER_LEN;
+  if (fits) {
+    u16q_push(q, data);
+  } else {
+    LINK_STAT_ADD(self, queue_overflows);
+  }
+  LINK_UNLOCK(&self->state);
+  return fits;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Copy the connection state as of the last serial IRQ (or reset) to `out`, all from the
+ * same moment (all zeros unless LINK_ENABLE_SNAPSHOT is defined). It never makes the
+ * IRQ handlers wait: if one publishes a newer state during the copy, the copy starts over.
+ */
+static inline void lc_snapshot(LinkConnection *self, LinkSnapshot *out) {
+#ifdef LINK_ENABLE_SNAPSHOT
+  u32 seq;
+  do {
+    seq = self->snapshot_seq;
+    *out = self->snapshot;
+  } while ((seq & 1) || seq != self->snapshot_seq);
+#else
+  *out = (LinkSnapshot) {};
+#endif
+}
+
+static inline bool lc_is_connected(LinkConnection *self) {
+  return linkstate_is_connected(&self->state);
+}
+static inline bool lc_has_message(LinkConnection *self, u8 player_id) {
+  return linkstate_has_message(&self->state, player_id);
+}
+/**
+ * Return the last message received from `player_id`, whether it was read or not
+ * (LINK_NO_DATA if there's none, or without LINK_ENABLE_DELTA), and store in `since`
+ * (if not NULL) the `lc_frame` it changed on. With `delta_refresh`, this is the value
+ * the player holds.
+ */
+static inline u16 lc_held_value(LinkConnection *self, u8 player_id, u32 *since) {
+#ifdef LINK_ENABLE_DELTA
+  LINK_LOCK(&self->state);
+  u16 value = self->held[player_id];
+  if (since) {
+    *since = self->held_since[player_id];
+  }
+  LINK_UNLOCK(&self->state);
+  return value;
+#else
+  if (since) {
+    *since = 0;
+  }
+  return LINK_NO_DATA;
+#endif
+}
+/**
+ * Number of VBlanks since `lc_activate`.
+ */
+static inline u32 lc_frame(LinkConnection *self) {
+  return self->frame;
+}
+/**
+ * Send `len` words as one packet protected by a CRC16: receivers deliver all of them
+ * (as normal messages) or none. Returns false without sending anything if a word is
+ * a reserved value or the packet doesn't fit in the outgoing queue (nor without LINK_ENABLE_CRC16).
+ */
+static inline bool lc_send_packet(LinkConnection *self, const u16 *data, u32 len) {
+#ifdef LINK_ENABLE_CRC16
+  lc_record_other(self, LINK_RECORD_CALL_PACKET, 0, len, 0, data);
+  u32 needed = 4 + len;
+  for (u32 i = 0; i < len; i++) {
+    if (data[i] == LINK_DISCONNECTED || data[i] == LINK_NO_DATA) {
+      LINK_STAT_ADD(self, send_rejects);
+      return false;
+    }
+    if (data[i] >= LINK_CTRL_BASE) {
+      needed++;
+    }
+  }
+
+  U16Queue *q = &self->state.outgoing_messages;
+  LINK_LOCK(&self->state);
+#ifdef LINK_ENABLE_CHANNELS
+  needed += lc_channels_tag_len(self, 0);
+#endif
+  bool fits = q->len + needed <= self->buffer_len;
+  if (fits) {
+    u16 crc = lc_crc16(data, len);
+#ifdef LINK_ENABLE_CHANNELS
+    lc_channels_tag(self, 0);
+#endif
+    u16q_push(q, LINK_CTRL(LINK_OP_PACKET, 0));
+    for (u32 i = 0; i < len; i++) {
+      lc_queue_message(self, data[i]);
+    }
+    u16q_push(q, LINK_CRC16_WORD(crc >> 8));
+    u16q_push(q, LINK_CRC16_WORD(crc & 0xFF));
+    u16q_push(q, LINK_CTRL(LINK_OP_PACKET_END, 0));
+    LINK_STAT_MAX(self, outgoing_high_water, q->len);
+  } else {
+    LINK_STAT_ADD(self, queue_overflows);
+  }
+  LINK_UNLOCK(&self->state);
+  return fits;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Return the next message from `player_id` without removing it (LINK_NO_DATA if there's none).
+ */
+static inline u16 lc_peek_message(LinkConnection *self, u8 player_id) {
+  LINK_LOCK(&self->state);
+  U16Queue *q = &self->state.incoming_messages[player_id];
+  u16 message = linkstate_available(&self->state, player_id) > 0 ? u16q_front(q) : LINK_NO_DATA;
+  LINK_UNLOCK(&self->state);
+  return message;
+}
+static inline u16 lc_read_message(LinkConnection *self, u8 player_id) {
+  lc_record_call(self, true, player_id, 0);
+  return linkstate_read_message(&self->state, player_id);
+}
+
+/**
+ * Queue `len` bytes from `buf` for all the other players, as a stream: bytes written
+ * in the same frame travel two per transfer (see LINK_ENABLE_BYTES). Returns how many
+ * were queued, fewer than `len` if LINK_BYTES_BUFFER_LEN bytes are waiting already
+ * (0 without LINK_ENABLE_BYTES). The stream is lossless through transfer errors
+ * (it relies on LINK_ENABLE_RELIABLE), but a reset clears it like any queue.
+ */
+static inline u32 lc_write(LinkConnection *self, const void *buf, u32 len) {
+#ifdef LINK_ENABLE_BYTES
+  lc_record_other(self, LINK_RECORD_CALL_WRITE, 0, len, 0, buf);
+  U8Queue *q = &self->state.tx_bytes;
+  LINK_LOCK(&self->state);
+  u32 written = u8q_write(q, buf, len);
+  if (q->len >= LINK_BYTES_RUN * 2) {
+    lc_bytes_flush(self);
+  }
+  if (written < len) {
+    LINK_STAT_ADD(self, queue_overflows);
+  }
+  LINK_UNLOCK(&self->state);
+  return written;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Move up to `len` bytes received from `player_id` to `buf`. Returns how many were read.
+ */
+static inline u32 lc_read(LinkConnection *self, u8 player_id, void *buf, u32 len) {
+#ifdef LINK_ENABLE_BYTES
+  lc_record_other(self, LINK_RECORD_CALL_READ, player_id, len, 0, NULL);
+  LINK_LOCK(&self->state);
+  u32 read = u8q_read(&self->state.rx_bytes[player_id], buf, len);
+  LINK_UNLOCK(&self->state);
+  return read;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Queue one byte (see `lc_write`). Returns false if it doesn't fit.
+ */
+static inline bool lc_send_byte(LinkConnection *self, u8 byte) {
+  return lc_write(self, &byte, 1) == 1;
+}
+
+/**
+ * Number of bytes received from `player_id` that can be read.
+ */
+static inline u32 lc_bytes_available(LinkConnection *self, u8 player_id) {
+#ifdef LINK_ENABLE_BYTES
+  return self->state.rx_bytes[player_id].len;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Store the next byte from `player_id` in `out`. Returns false if there's none.
+ */
+static inline bool lc_read_byte(LinkConnection *self, u8 player_id, u8 *out) {
+  return lc_read(self, player_id, out, 1) == 1;
+}
+
+/**
+ * Queue `data` on `channel` (0 is the same as `lc_send`). Returns false if it's a
+ * reserved value, the channel doesn't exist or its queue is full (always, for
+ * channels 1+, without LINK_ENABLE_CHANNELS).
+ */
+static inline bool lc_channel_send(LinkConnection *self, u8 channel, u16 data) {
+  if (channel == 0) {
+    return lc_send(self, data);
+  }
+#ifdef LINK_ENABLE_CHANNELS
+  lc_record_other(self, LINK_RECORD_CALL_CHANNEL_SEND, 0, channel, data, NULL);
+  if (channel >= LINK_CHANNELS || data == LINK_DISCONNECTED || data == LINK_NO_DATA) {
+    LINK_STAT_ADD(self, send_rejects);
+    return false;
+  }
+  U16Queue *q = &self->state.channel_out[channel - 1];
+  LINK_LOCK(&self->state);
+  bool fits = q->len < self->buffer_len;
+  if (fits) {
+    u16q_push(q, data);
+  } else {
+    LINK_STAT_ADD(self, queue_overflows);
+  }
+  LINK_UNLOCK(&self->state);
+  return fits;
+#else
+  return false;
+#endif
+}
+
+static inline bool lc_channel_has_message(LinkConnection *self, u8 channel, u8 player_id) {
+  if (channel == 0) {
+    return lc_has_message(self, player_id);
+  }
+#ifdef LINK_ENABLE_CHANNELS
+  return channel < LINK_CHANNELS && !u16q_empty(&self->state.channel_in[channel - 1][player_id]);
+#else
+  return false;
+#endif
+}
+
+/**
+ * Return the next message from `player_id` on `channel` (LINK_NO_DATA if there's none).
+ */
+static inline u16 lc_channel_read(LinkConnection *self, u8 channel, u8 player_id) {
+  if (channel == 0) {
+    return lc_read_message(self, player_id);
+  }
+#ifdef LINK_ENABLE_CHANNELS
+  lc_record_other(self, LINK_RECORD_CALL_CHANNEL_READ, player_id, channel, 0, NULL);
+  if (channel >= LINK_CHANNELS) {
+    return LINK_NO_DATA;
+  }
+  U16Queue *q = &self->state.channel_in[channel - 1][player_id];
+  LINK_LOCK(&self->state);
+  u16 message = u16q_empty(q) ? LINK_NO_DATA : LINK_QUEUE_POP(q);
+  LINK_UNLOCK(&self->state);
+  return message;
+#else
+  return LINK_NO_DATA;
+#endif
+}
+
+/**
+ * Set how much of the spare bandwidth `channel` (1+) gets relative to the others
+ * (default: 1). Channels with weight 0 have strict priority over the weighted ones,
+ * lower numbers first. Channel 0 always goes first.
+ */
+static inline void lc_channel_weight(LinkConnection *self, u8 channel, u8 weight) {
+#ifdef LINK_ENABLE_CHANNELS
+  lc_record_other(self, LINK_RECORD_CALL_CHANNEL_WEIGHT, 0, channel, weight, NULL);
+  if (channel > 0 && channel < LINK_CHANNELS) {
+    LINK_LOCK(&self->state);
+    self->channel_weight[channel] = weight;
+    self->channel_credit[channel] = 0;
+    LINK_UNLOCK(&self->state);
+  }
+#endif
+}
+
+/**
+ * Move the oldest event reported by the IRQ handlers to `out` (see LinkEvent). Returns
+ * false if there's none. Call it until it does, e.g. once per frame. A RESET means every
+ * player left: they join again with new JOINED events.
+ */
+static inline bool lc_next_event(LinkConnection *self, LinkEvent *out) {
+#ifdef LINK_ENABLE_EVENTS
+  LINK_LOCK(&self->state);
+  bool found = self->event_count > 0;
+  if (found) {
+    *out = self->events[self->event_next];
+    self->event_next = (self->event_next + 1) % LINK_EVENT_BUFFER_LEN;
+    self->event_count--;
+  }
+  LINK_UNLOCK(&self->state);
+  return found;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Set the functions that report what happens on the link (NULL ones are skipped). With
+ * `from_irq`, they're called from the IRQ handlers as soon as it happens, so they must be
+ * short and can't call other `lc_` functions; `on_message` gets every message as it
+ * becomes readable, and events skip the `lc_next_event` queue. Otherwise, `lc_dispatch`
+ * calls them. Messages of channels 1+ and bytes still have to be read (does nothing
+ * without LINK_ENABLE_CALLBACKS).
+ */
+static inline void lc_set_callbacks(LinkConnection *self, LinkCallbacks callbacks) {
+#ifdef LINK_ENABLE_CALLBACKS
+  lc_record_other(self, LINK_RECORD_CALL_CALLBACKS, 0, callbacks.from_irq, callbacks.on_message != NULL, NULL);
+  LINK_LOCK(&self->state);
+  self->callbacks = callbacks;
+  LINK_UNLOCK(&self->state);
+#endif
+}
+
+/**
+ * Report what happened since the last call: the events from `lc_next_event`, in order,
+ * and then the messages received from each player (read with `lc_read_message`). Call it
+ * once per frame instead of polling. Returns the number of events and messages reported
+ * (0 if the callbacks are called `from_irq`, or without LINK_ENABLE_CALLBACKS).
+ */
+static inline u32 lc_dispatch(LinkConnection *self) {
+  u32 calls = 0;
+#ifdef LINK_ENABLE_CALLBACKS
+  LinkCallbacks *callbacks = &self->callbacks;
+  if (callbacks->from_irq) {
+    return 0;
+  }
+  LinkEvent event;
+  for (; lc_next_event(self, &event); calls++) {
+    lc_callbacks_on_event(callbacks, &event);
+  }
+  for (u32 i = 0; i < LINK_MAX_PLAYERS && callbacks->on_message; i++) {
+    // Only the ones already here, so a fast sender can't keep this going.
+    for (u32 count = linkstate_available(&self->state, i); count > 0; count--, calls++) {
+      u16 message = lc_read_message(self, i);
+      if (message == LINK_NO_DATA) {
+        break;
+      }
+      callbacks->on_message(callbacks->context, i, message);
+    }
+  }
+#endif
+  return calls;
+}
+
+/**
+ * Copy the connection counters to `out` (all zeros unless LINK_ENABLE_STATS is defined).
+ */
+static inline void lc_get_stats(LinkConnection *self, LinkStats *out) {
+#ifdef LINK_ENABLE_STATS
+  LINK_LOCK(&self->state);
+  *out = self->stats;
+  LINK_UNLOCK(&self->state);
+#else
+  *out = (LinkStats) {};
+#endif
+}
+
+static inline void lc_reset_stats(LinkConnection *self) {
+#ifdef LINK_ENABLE_STATS
+  LINK_LOCK(&self->state);
+  self->stats = (LinkStats) {};
+  LINK_UNLOCK(&self->state);
+#endif
+}
+
+/**
+ * Start comparing game state checksums with the other players, one window of `every`
+ * frames at a time (a checksum costs six out-of-band transfers per window). `on_desync(context,
+ * player_id, window_start)` is called once per player, from `lc_checksum_submit`, with the
+ * first frame of the earliest window that didn't match: only the window's folded checksum
+ * is sent, so the desync happened somewhere in `window_start` to `window_start + every - 1`.
+ * Every player must start together.
+ */
+static inline void lc_checksum_start(LinkConnection *self, u32 every, LinkDesyncCallback on_desync, void *context) {
+#ifdef LINK_ENABLE_CHECKSUM
+  lc_record_other(self, LINK_RECORD_CALL_CHECKSUM_START, 0, every, 0, NULL);
+  LINK_LOCK(&self->state);
+  self->check_every = every;
+  self->on_desync = on_desync;
+  self->desync_context = context;
+  self->check_fold = 0;
+  self->check_window = 0;
+  self->checks = 0;
+  self->check_skips = 0;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->check_tag[i] = -1;
+    self->desync_window_start[i] = LINK_CHECKSUM_NONE;
+    self->desync_reported[i] = false;
+    for (u32 j = 0; j < LINK_CHECKSUM_WINDOWS; j++) {
+      self->check_remote_window[i][j] = 0;
+    }
+  }
+  LINK_UNLOCK(&self->state);
+#endif
+}
+
+/**
+ * Add the checksum of the game state after `frame` (e.g. a CRC16 of it). Call it for
+ * every frame in order, starting at 0, and only for final states (with rollback, the
+ * frames every input is confirmed for).
+ */
+static inline void lc_checksum_submit(LinkConnection *self, u32 frame, u16 checksum) {
+#ifdef LINK_ENABLE_CHECKSUM
+  lc_record_other(self, LINK_RECORD_CALL_CHECKSUM, 0, frame, checksum, NULL);
+  if (self->check_every == 0) {
+    return;
+  }
+  self->check_fold = ((self->check_fold << 1) | (self->check_fold >> 15)) ^ checksum;
+  if (frame % self->check_every == self->check_every - 1) {
+    u32 window = frame / self->check_every;
+    u16 word = LINK_CHECKSUM_WORD(self->check_fold);
+    self->check_fold = 0;
+
+    LINK_LOCK(&self->state);
+    U16Queue *control = &self->state.control_messages;
+    if (control->len + 1 + LINK_CHECKSUM_DIGITS <= LINK_CONTROL_BUFFER_LEN) {
+      u16q_push(control, LINK_CTRL(LINK_OP_CHECK, LINK_CHECK_START | (window & (LINK_CHECKSUM_WINDOWS - 1))));
+      for (s32 shift = (LINK_CHECKSUM_DIGITS - 1) * 3; shift >= 0; shift -= 3) {
+        u16q_push(control, LINK_CTRL(LINK_OP_CHECK, (word >> shift) & 0b111));
+      }
+    } else {
+      self->check_skips++;
+    }
+    self->check_local[window & (LINK_CHECKSUM_WINDOWS - 1)] = word;
+    self->check_window = window + 1;
+    for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+      if (i != self->state.current_player_id) {
+        lc_checksum_compare(self, i, window);
+      }
+    }
+    LINK_UNLOCK(&self->state);
+  }
+
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    if (self->desync_window_start[i] != LINK_CHECKSUM_NONE && !self->desync_reported[i]) {
+      self->desync_reported[i] = true;
+      if (self->on_desync) {
+        self->on_desync(self->desync_context, i, self->desync_window_start[i]);
+      }
+    }
+  }
+#endif
 }
 
-static inline void lc_send_pending_data(LinkConnection *self) {
-  lc_transfer(self, LINK_QUEUE_POP(&self->state.outgoing_messages));
+/**
+ * Queue a latency probe behind the pending messages. Every connected player answers it,
+ * and the round trip is added to `lc_get_latency`. A ping replaces any unanswered one.
+ * Returns false if the outgoing queue is full (or without LINK_ENABLE_PING).
+ */
+static inline bool lc_ping(LinkConnection *self) {
+#ifdef LINK_ENABLE_PING
+  lc_record_other(self, LINK_RECORD_CALL_PING, 0, 0, 0, NULL);
+  U16Queue *q = &self->state.outgoing_messages;
+  bool queued = false;
+  LINK_LOCK(&self->state);
+  if (q->len < self->buffer_len) {
+    for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+      if (self->ping_waiting & (1 << i)) {
+        self->latency[i].lost++;
+      }
+    }
+    self->ping_seq = (self->ping_seq + 1) & LINK_PING_SEQ_MASK;
+    self->ping_waiting = 0;
+    for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+      if (i != self->state.current_player_id && self->state.timeouts[i] != LINK_REMOTE_TIMEOUT_OFFLINE) {
+        self->ping_waiting |= 1 << i;
+      }
+    }
+    self->ping_time = lc_clock_now();
+    u16q_push(q, LINK_CTRL(LINK_OP_PING, self->ping_seq));
+    LINK_STAT_MAX(self, outgoing_high_water, q->len);
+    queued = true;
+  } else {
+    LINK_STAT_ADD(self, queue_overflows);
+  }
+  LINK_UNLOCK(&self->state);
+  return queued;
+#else
+  return false;
+#endif
 }
 
-static inline void lc_stop_timer(LinkConnection *self) {
-  REG_TM[self->send_timer_id].cnt = REG_TM[self->send_timer_id].cnt & (~TM_ENABLE);
+/**
+ * Copy the round-trip statistics for `player_id` to `out` (all zeros without LINK_ENABLE_PING).
+ */
+static inline void lc_get_latency(LinkConnection *self, u8 player_id, LinkLatency *out) {
+#ifdef LINK_ENABLE_PING
+  LINK_LOCK(&self->state);
+  *out = self->latency[player_id];
+  LINK_UNLOCK(&self->state);
+#else
+  *out = (LinkLatency) {};
+#endif
 }
 
-static inline void lc_start_timer(LinkConnection *self) {
-  REG_TM[self->send_timer_id].start = -(self->interval);
-  REG_TM[self->send_timer_id].cnt = TM_ENABLE | TM_IRQ | LINK_BASE_FREQUENCY;
+static inline void lc_reset_latency(LinkConnection *self) {
+#ifdef LINK_ENABLE_PING
+  LINK_LOCK(&self->state);
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->latency[i] = (LinkLatency) {};
+  }
+  LINK_UNLOCK(&self->state);
+#endif
 }
 
-static inline void lc_stop(LinkConnection *self) {
-  lc_stop_timer(self);
-
-  LINK_SET_LOW(REG_RCNT, LINK_BIT_GENERAL_PURPOSE_LOW);
-  LINK_SET_HIGH(REG_RCNT, LINK_BIT_GENERAL_PURPOSE_HIGH);
+/**
+ * Start sending `len` bytes from `src` (ROM, EWRAM or SRAM: it's read as it goes out,
+ * so it must stay valid until the transfer ends). Every connected player must have
+ * called `lc_bulk_receive` first. Returns false if a send is already active, `len`
+ * is 0 (or without LINK_ENABLE_BULK).
+ */
+static inline bool lc_bulk_send(LinkConnection *self, const void *src, u32 len) {
+#ifdef LINK_ENABLE_BULK
+  if (len == 0 || self->bulk_tx.status == LINK_BULK_ACTIVE) {
+    return false;
+  }
+  LINK_LOCK(&self->state);
+  self->bulk_tx = (LinkBulk) {
+    .src = src,
+    .len = len,
+    .status = LINK_BULK_ACTIVE,
+    .phase = LINK_BULK_TX_BEGIN,
+    .waiting = 0xFF,
+    .reported = 0xFFFFFFFF,
+  };
+  LINK_UNLOCK(&self->state);
+  lc_bulk_pace(self, true);
+  return true;
+#else
+  return false;
+#endif
 }
 
-static inline void lc_start(LinkConnection *self) {
-  lc_start_timer(self);
-
-  LINK_SET_LOW(REG_RCNT, LINK_BIT_GENERAL_PURPOSE_HIGH);
-  REG_SIOCNT = self->baud_rate;
-  REG_SIOMLT_SEND = 0;
-  setBitHigh(LINK_BIT_MULTIPLAYER);
-  setBitHigh(LINK_BIT_IRQ);
+/**
+ * Start receiving a blob sent by `player_id` into `dst`. Blobs longer than `cap` bytes
+ * fail. Chunks are written in place as they arrive, so `dst` can be in SRAM, and only
+ * count once their CRC matches. Returns false if a receive from that player is already
+ * active (or without LINK_ENABLE_BULK).
+ */
+static inline bool lc_bulk_receive(LinkConnection *self, u8 player_id, void *dst, u32 cap) {
+#ifdef LINK_ENABLE_BULK
+  LinkBulk *rx = &self->bulk_rx[player_id];
+  if (player_id >= LINK_MAX_PLAYERS || rx->status == LINK_BULK_ACTIVE) {
+    return false;
+  }
+  LINK_LOCK(&self->state);
+  // A chunk being skipped keeps its parsing state, so its words still don't leak as messages.
+  rx->dst = dst;
+  rx->cap = cap;
+  rx->len = 0;
+  rx->chunk = 0;
+  rx->reported = 0xFFFFFFFF;
+  rx->status = LINK_BULK_ACTIVE;
+  LINK_UNLOCK(&self->state);
+  lc_bulk_pace(self, true);
+  return true;
+#else
+  return false;
+#endif
 }
 
-static inline void lc_reset(LinkConnection *self) {
-  lc_reset_state(self);
-  lc_stop(self);
-  lc_start(self);
+/**
+ * Stop receiving from `player_id` (e.g. when it reports a failed send). Words of a chunk
+ * in progress are still skipped.
+ */
+static inline void lc_bulk_stop_receive(LinkConnection *self, u8 player_id) {
+#ifdef LINK_ENABLE_BULK
+  LINK_LOCK(&self->state);
+  if (self->bulk_rx[player_id].status == LINK_BULK_ACTIVE) {
+    self->bulk_rx[player_id].status = LINK_BULK_IDLE;
+  }
+  LINK_UNLOCK(&self->state);
+#endif
 }
 
-static inline bool lc_reset_if_needed(LinkConnection *self) {
-  if (!lc_is_ready(self) || lc_has_error(self)) {
-    lc_reset(self);
-    return true;
+/**
+ * Call once per frame while transfers are active. `on_progress(context, player_id, done, total)`
+ * is called for every transfer that made progress (`player_id` is this console for the send;
+ * `total` is 0 until the length of a received blob is known). Restores `interval` when the
+ * last transfer ends. Returns true while any transfer is active.
+ */
+static inline bool lc_bulk_update(LinkConnection *self, LinkBulkCallback on_progress, void *context) {
+#ifdef LINK_ENABLE_BULK
+  bool active = false;
+  for (u32 i = 0; i <= LINK_MAX_PLAYERS; i++) {
+    LinkBulk *bulk = i < LINK_MAX_PLAYERS ? &self->bulk_rx[i] : &self->bulk_tx;
+    if (bulk->status == LINK_BULK_IDLE) {
+      continue;
+    }
+    active |= bulk->status == LINK_BULK_ACTIVE;
+    u32 done = lc_bulk_done(bulk);
+    if (done != bulk->reported) {
+      bulk->reported = done;
+      if (on_progress) {
+        on_progress(context, i < LINK_MAX_PLAYERS ? i : self->state.current_player_id, done, bulk->len);
+      }
+    }
   }
+  if (!active) {
+    lc_bulk_pace(self, false);
+  }
+  return active;
+#else
   return false;
+#endif
 }
 
-static inline void lc_push(LinkConnection *self, U16Queue *q, u16 value) {
-  if (q->len >= self->buffer_len) {
-    LINK_QUEUE_POP(q);
-  }
-  u16q_push(q, value);
+/**
+ * State of the last `lc_bulk_send`: LINK_BULK_IDLE, _ACTIVE, _DONE (every player has it) or
+ * _FAILED (a chunk wasn't acknowledged after LINK_BULK_MAX_TRIES sends).
+ */
+static inline u8 lc_bulk_send_status(LinkConnection *self) {
+#ifdef LINK_ENABLE_BULK
+  return self->bulk_tx.status;
+#else
+  return LINK_BULK_IDLE;
+#endif
 }
 
-
-// Public API
-// ----------
+/**
+ * State of the last `lc_bulk_receive` from `player_id` (_FAILED: too long, or the player left).
+ */
+static inline u8 lc_bulk_receive_status(LinkConnection *self, u8 player_id) {
+#ifdef LINK_ENABLE_BULK
+  return self->bulk_rx[player_id].status;
+#else
+  return LINK_BULK_IDLE;
+#endif
+}
 
 /**
- * Initialise a link connection, providing existing memory for the message queues.
- * 
- * Note: `buffer_mem` should point to a region of size (LINK_TOTAL_BUFFERS * buffer_len * sizeof(u16))
+ * Bytes of the blob from `player_id` that are already in `dst`, checked. They can be used
+ * (e.g. decoded with `lc_lz77_decode`) while the rest arrives.
  */
-static inline LinkConnection lc_init_manual(LinkConnectionSettings settings, u16 *buffer_mem) {
-  LinkConnection self = {
-    .state = linkstate_init(settings.buffer_len, buffer_mem),
-    .baud_rate = settings.baud_rate,
-    .timeout = settings.timeout,
-    .remote_timeout = settings.remote_timeout,
-    .buffer_len = settings.buffer_len,
-    .interval = settings.interval,
-    .send_timer_id = settings.send_timer_id,
-  };
-  lc_stop(&self);
-  return self;
+static inline u32 lc_bulk_received(LinkConnection *self, u8 player_id) {
+#ifdef LINK_ENABLE_BULK
+  return lc_bulk_done(&self->bulk_rx[player_id]);
+#else
+  return 0;
+#endif
 }
 
 /**
- * Initialise a link connection.
+ * Length in bytes of the blob being received from `player_id` (0 until its first chunk arrives).
  */
-static inline LinkConnection lc_init(LinkConnectionSettings settings) {
-  u16 *buffer_mem = malloc(LINK_TOTAL_BUFFERS * settings.buffer_len * sizeof(u16));
-  LinkConnection result = lc_init_manual(settings, buffer_mem);
-  result.buffer_mem = buffer_mem;
-  return result;
+static inline u32 lc_bulk_received_len(LinkConnection *self, u8 player_id) {
+#ifdef LINK_ENABLE_BULK
+  return self->bulk_rx[player_id].len;
+#else
+  return 0;
+#endif
 }
 
 /**
- * Close the link and deallocate the buffers (unless they were provided with `lc_init_manual`).
+ * Copy up to `max` of the most recent trace events to `out`, oldest first. Returns the number copied.
  */
-static inline void lc_destroy(LinkConnection *self) {
-  lc_stop(self);
-  if (self->buffer_mem) {
-    free(self->buffer_mem);
+static inline u32 lc_trace_dump(LinkConnection *self, LinkTraceEvent *out, u32 max) {
+#ifdef LINK_ENABLE_TRACE
+  self->trace_paused = true;
+  u32 count = self->trace_next < LINK_TRACE_LEN ? self->trace_next : LINK_TRACE_LEN;
+  if (count > max) {
+    count = max;
   }
+  u32 first = self->trace_next - count;
+  for (u32 i = 0; i < count; i++) {
+    out[i] = self->trace[(first + i) & (LINK_TRACE_LEN - 1)];
+  }
+  self->trace_paused = false;
+  return count;
+#else
+  return 0;
+#endif
 }
 
-static inline bool lc_is_active(LinkConnection *self) {
-  return self->is_enabled;
+/**
+ * Write the trace as a capture file (LinkTraceHeader + events) to byte-addressed
+ * memory such as SRAM. Returns the number of bytes written.
+ * `tools/link_trace_export` turns captures from one or more consoles into a Chrome trace.
+ */
+static inline u32 lc_trace_save(LinkConnection *self, vu8 *dst, u32 cap) {
+  LinkTraceHeader header = {
+    .magic = LINK_TRACE_MAGIC,
+    .version = LINK_TRACE_VERSION,
+    .event_size = sizeof(LinkTraceEvent),
+    .frequency = LINK_CLOCK_FREQUENCY,
+  };
+  if (cap < sizeof(header)) {
+    return 0;
+  }
+#ifdef LINK_ENABLE_TRACE
+  self->trace_paused = true;
+  u32 count = self->trace_next < LINK_TRACE_LEN ? self->trace_next : LINK_TRACE_LEN;
+  if (count > (cap - sizeof(header)) / sizeof(LinkTraceEvent)) {
+    count = (cap - sizeof(header)) / sizeof(LinkTraceEvent);
+  }
+  header.count = count;
+#endif
+  u32 written = 0;
+  for (u32 i = 0; i < sizeof(header); i++) {
+    dst[written++] = ((u8 *)&header)[i];
+  }
+#ifdef LINK_ENABLE_TRACE
+  u32 first = self->trace_next - count;
+  for (u32 i = 0; i < count; i++) {
+    u8 *event = (u8 *)&self->trace[(first + i) & (LINK_TRACE_LEN - 1)];
+    for (u32 j = 0; j < sizeof(LinkTraceEvent); j++) {
+      dst[written++] = event[j];
+    }
+  }
+  self->trace_paused = false;
+#endif
+  return written;
 }
 
-static inline void lc_activate(LinkConnection *self) {
-  lc_reset(self);
-  self->is_enabled = true;
+static inline void lc_trace_clear(LinkConnection *self) {
+#ifdef LINK_ENABLE_TRACE
+  self->trace_next = 0;
+#endif
 }
 
-static inline void lc_deactivate(LinkConnection *self) {
-  self->is_enabled = false;
-  lc_reset_state(self);
-  lc_stop(self);
-}
+/**
+ * Start recording the session to `dst` (e.g. SRAM or a debug buffer). Recording stops
+ * by itself when `cap` bytes are used. Returns false if `cap` can't even hold the header,
+ * or with LINK_ENABLE_BULK (transfers read the blobs straight from memory, and those
+ * aren't recorded).
+ */
+static inline bool lc_record_start(LinkConnection *self, vu8 *dst, u32 cap) {
+#if defined(LINK_ENABLE_RECORD) && !defined(LINK_ENABLE_BULK)
+  LinkRecordHeader header = {
+    .magic = LINK_RECORD_MAGIC,
+    .version = LINK_RECORD_VERSION,
+    .features = lc_features(),
+    .frequency = LINK_CLOCK_FREQUENCY,
+#ifdef LINK_ENABLE_AUTO_BAUD
+    .baud_rate = self->baud_max,
+#else
+    .baud_rate = self->baud_rate,
+#endif
+    .send_timer_id = self->send_timer_id,
+    .timeout = self->timeout,
+    .remote_timeout = self->remote_timeout,
+    .soft_resets = self->soft_resets,
+    .buffer_len = self->buffer_len,
+    .interval = self->interval,
+  };
+#ifdef LINK_ENABLE_DELTA
+  header.delta_refresh = self->delta_refresh;
+#endif
+#ifdef LINK_ENABLE_TIMEOUT_US
+  header.timeout_us = self->timeout_us;
+  header.remote_timeout_us = self->remote_timeout_us;
+#endif
+  if (cap < sizeof(header)) {
+    return false;
+  }
+  for (u32 i = 0; i < sizeof(header); i++) {
+    dst[i] = ((u8 *)&header)[i];
+  }
 
-static inline void lc_send(LinkConnection *self, u16 data) {
-  if (data == LINK_DISCONNECTED || data == LINK_NO_DATA) {
-    return;
+  u16 ime = REG_IME;
+  REG_IME = 0;
+  self->record_buf = dst;
+  self->record_cap = cap;
+  self->record_len = sizeof(header);
+  self->record_time = lc_clock_now();
+  // Registers start as zero in the replay, which is also how they're first compared.
+  self->record_siocnt = 0;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    self->record_data[i] = 0;
   }
-  self->state.is_locked = true;
-  u16q_push(&(self->state.outgoing_messages), data);
-  self->state.is_locked = false;
+  self->is_recording = true;
+  REG_IME = ime;
+  return true;
+#else
+  return false;
+#endif
 }
 
-static inline bool lc_is_connected(LinkConnection *self) {
-  return linkstate_is_connected(&self->state);
-}
-static inline bool lc_has_message(LinkConnection *self, u8 player_id) {
-  return linkstate_has_message(&self->state, player_id);
-}
-static inline u16 lc_read_message(LinkConnection *self, u8 player_id) {
-  return linkstate_read_message(&self->state, player_id);
+/**
+ * Stop recording and store the final length in the header. Returns the total size in bytes.
+ */
+static inline u32 lc_record_stop(LinkConnection *self) {
+#ifdef LINK_ENABLE_RECORD
+  u16 ime = REG_IME;
+  REG_IME = 0;
+  self->is_recording = false;
+  REG_IME = ime;
+
+  if (self->record_buf == NULL) {
+    return 0;
+  }
+  u32 length = self->record_len - sizeof(LinkRecordHeader);
+  vu8 *field = (vu8 *)&((volatile LinkRecordHeader *)self->record_buf)->length;
+  for (u32 i = 0; i < sizeof(u32); i++) {
+    field[i] = (length >> (i * 8)) & 0xFF;
+  }
+  return self->record_len;
+#else
+  return 0;
+#endif
 }
 
-static inline void lc_on_vblank(LinkConnection *self) {
-  if (!self->is_enabled || self->state.is_locked) {
+static inline void lc_handle_vblank(LinkConnection *self) {
+  self->frame++;
+  if (self->state.is_locked) {
+    LINK_STAT_ADD(self, locked_skips);
     return;
   }
   if (!self->state.irq_flag) {
     self->state.irq_timeout++;
   }
   self->state.irq_flag = false;
+#ifdef LINK_ENABLE_BYTES
+  lc_bytes_flush(self);
+#endif
 }
 
-static inline void lc_on_timer(LinkConnection *self) {
-  if (!self->is_enabled || self->state.is_locked) {
+static inline void lc_handle_timer(LinkConnection *self) {
+  if (self->state.is_locked) {
+    LINK_STAT_ADD(self, locked_skips);
     return;
   }
   if (lc_did_timeout(self)) {
+    LINK_STAT_ADD(self, resets_timeout);
     lc_reset(self);
+#ifdef LINK_ENABLE_EVENTS
+    lc_events_on_reset(self, LINK_RESET_TIMEOUT);
+#endif
     return;
   }
   if (lc_is_master(self) && lc_is_ready(self) && !lc_is_sending(self)) {
@@ -416,8 +4610,9 @@ static inline void lc_on_timer(LinkConnection *self) {
   }
 }
 
-static inline void lc_on_serial(LinkConnection *self) {
-  if (!self->is_enabled || self->state.is_locked) {
+static inline void lc_handle_serial(LinkConnection *self) {
+  if (self->state.is_locked) {
+    LINK_STAT_ADD(self, locked_skips);
     return;
   }
   
@@ -427,27 +4622,50 @@ static inline void lc_on_serial(LinkConnection *self) {
   
   self->state.irq_flag = true;
   self->state.irq_timeout = 0;
+  self->state.failures = 0;
+  LINK_STAT_ADD(self, transfers);
+#ifdef LINK_ENABLE_TIMEOUT_US
+  u32 now = self->state.irq_time = lc_clock_now();
+#else
+  u32 now = 0;
+#endif
   
   int new_player_count = 0;
+  self->state.current_player_id = (REG_SIOCNT & (0b11 << LINK_BITS_PLAYER_ID)) >> LINK_BITS_PLAYER_ID;
+#ifdef LINK_ENABLE_EVENTS
+  lc_events_on_transfer(self);
+#endif
   
   for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
     u16 data = REG_SIOMULTI[i];
     
     if (data != LINK_DISCONNECTED) {
       
-      if (data != LINK_NO_DATA && i != self->state.current_player_id) {
-        u16q_push(&self->state.incoming_messages[i], data);
+      if (i != self->state.current_player_id) {
+        if (self->state.timeouts[i] == LINK_REMOTE_TIMEOUT_OFFLINE) {
+          lc_on_player_connected(self, i);
+        }
+        if (data != LINK_NO_DATA) {
+          LINK_STAT_ADD(self, words_received[i]);
+          lc_receive(self, i, data);
+        } else {
+          lc_on_player_idle(self, i);
+        }
       }
       new_player_count++;
       self->state.timeouts[i] = 0;
+#ifdef LINK_ENABLE_TIMEOUT_US
+      self->state.seen_time[i] = now;
+#endif
       
     } else if (self->state.timeouts[i] > LINK_REMOTE_TIMEOUT_OFFLINE) {
       
       self->state.timeouts[i]++;
       
-      if (self->state.timeouts[i] >= (int)self->remote_timeout) {
+      if (lc_did_remote_timeout(self, i, now)) {
         LINK_QUEUE_CLEAR(&self->state.incoming_messages[i]);
         self->state.timeouts[i] = LINK_REMOTE_TIMEOUT_OFFLINE;
+        lc_on_player_disconnected(self, i);
       } else {
         new_player_count++;
       }
@@ -455,11 +4673,347 @@ static inline void lc_on_serial(LinkConnection *self) {
   }
   
   self->state.player_count = new_player_count;
-  self->state.current_player_id = (REG_SIOCNT & (0b11 << LINK_BITS_PLAYER_ID)) >> LINK_BITS_PLAYER_ID;
+#ifdef LINK_ENABLE_AUTO_BAUD
+  lc_baud_on_transfer(self);
+#endif
+#ifdef LINK_ENABLE_BULK
+  lc_bulk_on_transfer(self);
+#endif
+#ifdef LINK_ENABLE_SNAPSHOT
+  lc_publish(self);
+#endif
+#ifdef LINK_ENABLE_CALLBACKS
+  lc_callbacks_on_transfer(self);
+#endif
   
   if (!lc_is_master(self)) {
     lc_send_pending_data(self);
   }
 }
 
+static inline void lc_on_vblank(LinkConnection *self) {
+  if (!self->is_enabled) {
+    return;
+  }
+  lc_trace(self, LINK_EVENT_VBLANK);
+#ifdef LINK_ENABLE_RECORD
+  LinkRecordIrq record = lc_record_irq_begin(self, LINK_RECORD_VBLANK);
+  lc_handle_vblank(self);
+  lc_record_irq_end(self, &record);
+#else
+  lc_handle_vblank(self);
+#endif
+}
+
+static inline void lc_on_timer(LinkConnection *self) {
+  if (!self->is_enabled) {
+    return;
+  }
+  lc_trace(self, LINK_EVENT_TIMER);
+#ifdef LINK_ENABLE_RECORD
+  LinkRecordIrq record = lc_record_irq_begin(self, LINK_RECORD_TIMER);
+  lc_handle_timer(self);
+  lc_record_irq_end(self, &record);
+#else
+  lc_handle_timer(self);
+#endif
+}
+
+static inline void lc_on_serial(LinkConnection *self) {
+  if (!self->is_enabled) {
+    return;
+  }
+  lc_trace(self, LINK_EVENT_SERIAL);
+#ifdef LINK_ENABLE_RECORD
+  LinkRecordIrq record = lc_record_irq_begin(self, LINK_RECORD_SERIAL);
+  lc_handle_serial(self);
+  lc_record_irq_end(self, &record);
+#else
+  lc_handle_serial(self);
+#endif
+}
+
+
+// Lockstep
+// --------
+// Inputs travel as LINK_LOCKSTEP_WORD(frame, input), one per frame and player, so the
+// front of each incoming queue is always the next frame's input. While lockstep is
+// running, the connection shouldn't carry other messages.
+
+#ifdef LINK_ENABLE_LOCKSTEP
+static inline bool lc_lockstep_is_remote(LinkLockstep *self, u8 player) {
+  LinkState *state = &self->conn->state;
+  return player != state->current_player_id && state->timeouts[player] != LINK_REMOTE_TIMEOUT_OFFLINE;
+}
+
+// Drops stale words and returns how far ahead of `self->frame` the front input is
+// (0 = it's this frame's, > 0 = this frame's input was lost), or -1 if there's none yet.
+static inline int lc_lockstep_front(LinkLockstep *self, u8 player) {
+  LinkConnection *conn = self->conn;
+  while (lc_has_message(conn, player)) {
+    u16 word = lc_peek_message(conn, player);
+    u32 ahead = ((word >> LINK_LOCKSTEP_TAG_SHIFT) - self->frame) & LINK_LOCKSTEP_TAG_MASK;
+    if ((word & LINK_LOCKSTEP_FLAG) && ahead <= LINK_LOCKSTEP_TAG_MASK / 2) {
+      return ahead;
+    }
+    lc_read_message(conn, player);
+    self->dropped++;
+  }
+  return -1;
+}
+
+/**
+ * Start a lockstep session at frame 0 with `delay` frames of input delay (less than
+ * LINK_LOCKSTEP_FRAMES). The first `delay` frames run with neutral (0) inputs.
+ * Every player must start together, e.g. right after `lc_is_connected` becomes true.
+ */
+static inline LinkLockstep lc_lockstep_init(LinkConnection *conn, u8 delay) {
+  if (delay >= LINK_LOCKSTEP_FRAMES) {
+    delay = LINK_LOCKSTEP_FRAMES - 1;
+  }
+  return (LinkLockstep) {
+    .conn = conn,
+    .submitted = delay,
+    .delay = delay,
+  };
+}
+
+/**
+ * Send this console's input (up to LINK_LOCKSTEP_INPUT_MASK) for the frame `delay`
+ * frames after the current one. Call it once per frame; returns false if it's already
+ * submitted that far ahead or the outgoing queue is full (submit it again later).
+ */
+static inline bool lc_lockstep_submit(LinkLockstep *self, u16 input) {
+  if (self->submitted > self->frame + self->delay) {
+    return false;
+  }
+  input &= LINK_LOCKSTEP_INPUT_MASK;
+  if (!lc_send(self->conn, LINK_LOCKSTEP_WORD(self->submitted, input))) {
+    return false;
+  }
+  self->local[self->submitted & (LINK_LOCKSTEP_FRAMES - 1)] = input;
+  self->submitted++;
+  return true;
+}
+
+/**
+ * Whether every connected player's input for `frame` arrived. Only the next frame
+ * (`self->frame`) can be ready: frames are consumed in order by `lc_lockstep_inputs`.
+ */
+static inline bool lc_lockstep_ready(LinkLockstep *self, u32 frame) {
+  if (frame != self->frame || self->submitted <= frame) {
+    return false;
+  }
+  bool ready = true;
+  if (frame >= self->delay) {
+    for (u32 i = 0; i < LINK_MAX_PLAYERS && ready; i++) {
+      ready = !lc_lockstep_is_remote(self, i) || lc_lockstep_front(self, i) >= 0;
+    }
+  }
+
+  if (ready) {
+    self->current_stall = 0;
+  } else {
+    self->stalls++;
+    self->current_stall++;
+    if (self->current_stall > self->longest_stall) {
+      self->longest_stall = self->current_stall;
+    }
+  }
+  return ready;
+}
+
+/**
+ * Write the inputs for `frame` to `out` (indexed by player id; LINK_DISCONNECTED for
+ * absent players) and advance to the next frame. Returns false if it isn't ready.
+ */
+static inline bool lc_lockstep_inputs(LinkLockstep *self, u32 frame, u16 out[LINK_MAX_PLAYERS]) {
+  if (!lc_lockstep_ready(self, frame)) {
+    return false;
+  }
+  u8 current_player_id = self->conn->state.current_player_id;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    if (i == current_player_id) {
+      out[i] = self->local[frame & (LINK_LOCKSTEP_FRAMES - 1)];
+    } else if (!lc_lockstep_is_remote(self, i)) {
+      out[i] = LINK_DISCONNECTED;
+    } else if (frame < self->delay) {
+      out[i] = 0;
+    } else if (lc_lockstep_front(self, i) == 0) {
+      out[i] = lc_read_message(self->conn, i) & LINK_LOCKSTEP_INPUT_MASK;
+    } else {
+      out[i] = self->last[i];
+      self->lost++;
+    }
+    if (out[i] != LINK_DISCONNECTED) {
+      self->last[i] = out[i];
+    }
+  }
+  self->frame++;
+  return true;
+}
+#endif
+
+
+// Rollback
+// --------
+// Inputs use the lockstep word format, but `lc_on_serial` writes them straight into
+// the history instead of the incoming queues. The game always runs the current frame,
+// predicting that missing inputs repeat the last confirmed one.
+
+#ifdef LINK_ENABLE_ROLLBACK
+static inline bool lc_rollback_is_remote(LinkRollback *self, u8 player) {
+  LinkState *state = &self->conn->state;
+  return player != state->current_player_id && state->timeouts[player] != LINK_REMOTE_TIMEOUT_OFFLINE;
+}
+
+// Queues INPUT and `word` together. Returns false if they don't fit.
+static inline bool lc_rollback_send(LinkConnection *conn, u16 word) {
+  lc_record_other(conn, LINK_RECORD_CALL_INPUT, 0, word, 0, NULL);
+  U16Queue *q = &conn->state.outgoing_messages;
+  LINK_LOCK(&conn->state);
+  u32 needed = 2;
+#ifdef LINK_ENABLE_CHANNELS
+  needed += lc_channels_tag_len(conn, 0);
+#endif
+  bool fits = q->len + needed <= conn->buffer_len;
+  if (fits) {
+#ifdef LINK_ENABLE_CHANNELS
+    lc_channels_tag(conn, 0);
+#endif
+    u16q_push(q, LINK_CTRL(LINK_OP_INPUT, 0));
+    u16q_push(q, word);
+    LINK_STAT_MAX(conn, outgoing_high_water, q->len);
+  } else {
+    LINK_STAT_ADD(conn, queue_overflows);
+  }
+  LINK_UNLOCK(&conn->state);
+  return fits;
+}
+
+/**
+ * Start a rollback session at frame 0 and attach it to `conn`, which then routes every
+ * input sent with `lc_rollback_submit` to `self` (so `self` must stay at the same address).
+ * `on_rollback(context, frame, count)` is called by `lc_rollback_update` when frames
+ * `frame` to `frame + count - 1` must be resimulated. Every player must start together.
+ */
+static inline void lc_rollback_init(LinkRollback *self, LinkConnection *conn, LinkRollbackCallback on_rollback,
+                                    void *context) {
+  lc_record_other(conn, LINK_RECORD_CALL_ROLLBACK, 0, 1, 0, NULL);
+  LINK_LOCK(&conn->state);
+  *self = (LinkRollback) {
+    .conn = conn,
+    .rollback_from = LINK_ROLLBACK_NONE,
+    .on_rollback = on_rollback,
+    .context = context,
+  };
+  conn->rollback = self;
+  LINK_UNLOCK(&conn->state);
+}
+
+/**
+ * Detach the session: received inputs go to the incoming queues again.
+ */
+static inline void lc_rollback_stop(LinkRollback *self) {
+  lc_record_other(self->conn, LINK_RECORD_CALL_ROLLBACK, 0, 0, 0, NULL);
+  LINK_LOCK(&self->conn->state);
+  self->conn->rollback = NULL;
+  LINK_UNLOCK(&self->conn->state);
+}
+
+/**
+ * Whether the game can run the current frame: false (a stall) if it's already
+ * LINK_ROLLBACK_MAX_PREDICT frames ahead of some player's last real input.
+ */
+static inline bool lc_rollback_ready(LinkRollback *self) {
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    if (lc_rollback_is_remote(self, i) && self->frame >= self->confirmed[i] + LINK_ROLLBACK_MAX_PREDICT) {
+      self->stalls++;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Send this console's input for the current frame. Call it once per frame, before
+ * `lc_rollback_inputs`. Returns false if the outgoing queue is full (submit it again).
+ */
+static inline bool lc_rollback_submit(LinkRollback *self, u16 input) {
+  u8 current_player_id = self->conn->state.current_player_id;
+  if (self->confirmed[current_player_id] > self->frame) {
+    return false;
+  }
+  input &= LINK_LOCKSTEP_INPUT_MASK;
+  if (!lc_rollback_send(self->conn, LINK_LOCKSTEP_WORD(self->frame, input))) {
+    return false;
+  }
+  self->inputs[current_player_id][self->frame & (LINK_ROLLBACK_FRAMES - 1)] = input;
+  self->confirmed[current_player_id] = self->frame + 1;
+  return true;
+}
+
+/**
+ * If a received input didn't match its prediction, call `on_rollback` with the frames
+ * to resimulate (from the first mispredicted one to the current one, exclusive) and
+ * return how many they are. Call it once per frame, before running the current one.
+ */
+static inline u32 lc_rollback_update(LinkRollback *self) {
+  LINK_LOCK(&self->conn->state);
+  u32 from = self->rollback_from;
+  self->rollback_from = LINK_ROLLBACK_NONE;
+  LINK_UNLOCK(&self->conn->state);
+  if (from == LINK_ROLLBACK_NONE || from >= self->frame) {
+    return 0;
+  }
+
+  u32 count = self->frame - from;
+  self->rollbacks++;
+  self->resimulated += count;
+  if (count > self->longest_rollback) {
+    self->longest_rollback = count;
+  }
+  if (self->on_rollback) {
+    self->on_rollback(self->context, from, count);
+  }
+  return count;
+}
+
+/**
+ * Write the inputs for `frame` (the current one, or a past one being resimulated) to `out`,
+ * indexed by player id (LINK_DISCONNECTED for absent players). Missing inputs are predicted
+ * and remembered, so a different real input triggers a rollback. Returns true if every
+ * input is real.
+ */
+static inline bool lc_rollback_inputs(LinkRollback *self, u32 frame, u16 out[LINK_MAX_PLAYERS]) {
+  bool confirmed = true;
+  LINK_LOCK(&self->conn->state);
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    u16 *history = self->inputs[i];
+    u32 last = self->confirmed[i];
+    if (i != self->conn->state.current_player_id && !lc_rollback_is_remote(self, i)) {
+      out[i] = LINK_DISCONNECTED;
+    } else if (frame < last) {
+      out[i] = history[frame & (LINK_ROLLBACK_FRAMES - 1)];
+    } else {
+      out[i] = last > 0 ? history[(last - 1) & (LINK_ROLLBACK_FRAMES - 1)] : 0;
+      history[frame & (LINK_ROLLBACK_FRAMES - 1)] = out[i];
+      confirmed = false;
+    }
+  }
+  if (frame >= self->fetched) {
+    self->fetched = frame + 1;
+  }
+  LINK_UNLOCK(&self->conn->state);
+  return confirmed;
+}
+
+/**
+ * Move on to the next frame, after running the current one.
+ */
+static inline void lc_rollback_advance(LinkRollback *self) {
+  self->frame++;
+}
+#endif
+
 #endif  // LINK_CONNECTION_H
\ No newline at end of file
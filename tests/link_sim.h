@@ -0,0 +1,154 @@
+#ifndef LINK_SIM_H
+#define LINK_SIM_H
+
+/*
+link_sim - Runs several consoles of `link_connection.h` on the PC, wired together.
+
+Each console has its own I/O registers (see tools/include), and the tests play
+the part of the hardware: `sim_timer` fires every console's timer IRQ (or ticks its
+`settings.scheduler`) and, if the master started a transfer, delivers the words
+everyone wrote to REG_SIOMLT_SEND to everyone, one serial IRQ per console.
+A transfer fails on a console (error bit set, garbage in REG_SIOMULTI) with
+probability `sim.error_rate` / 65536, or when `sim.drop` returns true for it.
+`sim.tamper` can change the words a console gets from a good transfer instead.
+It fails on all of them while their baud rates differ. Everything is
+deterministic for a given `seed`.
+
+  sim_init(3, settings, 1234);
+  for (...) {
+    sim_select(1);
+    lc_send(&sim.conns[1], value);
+    sim_timer();
+  }
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tonc_core.h"
+#include "../link_connection.h"
+
+#define SIM_MAX_CONSOLES 4
+
+typedef struct Sim {
+  u32 n;                                         // Consoles, master first
+  LinkConnection conns[SIM_MAX_CONSOLES];
+  volatile u16 io[SIM_MAX_CONSOLES][LINK_HOST_IO_SIZE / 2];
+  u32 clock;                                     // Clock ticks, `interval` * 1024 per timer IRQ
+  u32 interval;
+  u32 random;
+  u32 error_rate;                                // Failed transfers per 65536
+  bool (*drop)(u32 console, const u16 *words);   // Makes the transfer fail on `console` (optional)
+  void (*tamper)(u32 console, u16 *words);       // Changes what `console` receives, without an error (optional)
+  u32 transfers;
+} Sim;
+
+static Sim sim;
+volatile u16 *lc_host_io = sim.io[0];
+
+static inline u32 sim_random(void) {
+  // xorshift32: the same sequence on every host.
+  sim.random ^= sim.random << 13;
+  sim.random ^= sim.random >> 17;
+  sim.random ^= sim.random << 5;
+  return sim.random;
+}
+
+// Points the registers to `console`, and wires its SIOCNT as the master or a slave.
+static inline void sim_select(u32 console) {
+  lc_host_io = sim.io[console];
+  u16 siocnt = REG_SIOCNT & ~((1 << LINK_BIT_SLAVE) | (1 << LINK_BIT_READY) | (0b11 << LINK_BITS_PLAYER_ID) |
+                              (1 << LINK_BIT_ERROR));
+  siocnt |= (1 << LINK_BIT_READY) | (console << LINK_BITS_PLAYER_ID) | (console > 0 ? 1 << LINK_BIT_SLAVE : 0);
+  REG_SIOCNT = siocnt;
+  REG_TM[LINK_CLOCK_TIMER].count = sim.clock & 0xFFFF;
+  REG_TM[LINK_CLOCK_TIMER + 1].count = sim.clock >> 16;
+}
+
+static inline void sim_vblank(void) {
+  for (u32 i = 0; i < sim.n; i++) {
+    sim_select(i);
+    lc_on_vblank(&sim.conns[i]);
+  }
+}
+
+static inline void sim_timer(void) {
+  sim.clock += sim.interval * 1024;
+  for (u32 i = 0; i < sim.n; i++) {
+    sim_select(i);
+    if (sim.conns[i].scheduler) {
+      lc_scheduler_on_timer(sim.conns[i].scheduler);
+    } else {
+      lc_on_timer(&sim.conns[i]);
+    }
+  }
+  sim_select(0);
+  if (!(REG_SIOCNT & (1 << LINK_BIT_START))) {
+    return;
+  }
+  sim.transfers++;
+  u16 words[LINK_MAX_PLAYERS];
+  bool mismatch = false;
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    words[i] = i < sim.n ? sim.io[i][0x012A / 2] : LINK_DISCONNECTED;
+    mismatch = mismatch || (i < sim.n && (sim.io[i][0x0128 / 2] & 0b11) != (REG_SIOCNT & 0b11));
+  }
+  for (u32 i = 0; i < sim.n; i++) {
+    sim_select(i);
+    REG_SIOCNT &= ~(1 << LINK_BIT_START);
+    bool fails = (sim_random() & 0xFFFF) < sim.error_rate || (sim.drop && sim.drop(i, words)) || mismatch;
+    u16 received[LINK_MAX_PLAYERS];
+    for (u32 j = 0; j < LINK_MAX_PLAYERS; j++) {
+      received[j] = fails ? sim_random() : words[j];
+    }
+    if (sim.tamper && !fails) {
+      sim.tamper(i, received);
+    }
+    for (u32 j = 0; j < LINK_MAX_PLAYERS; j++) {
+      REG_SIOMULTI[j] = received[j];
+    }
+    if (fails) {
+      REG_SIOCNT |= 1 << LINK_BIT_ERROR;
+    }
+    lc_on_serial(&sim.conns[i]);
+  }
+}
+
+// Runs `count` timer IRQs, with a VBlank every `per_vblank` of them.
+static inline void sim_run(u32 count, u32 per_vblank) {
+  for (u32 i = 1; i <= count; i++) {
+    sim_timer();
+    if (i % per_vblank == 0) {
+      sim_vblank();
+    }
+  }
+}
+
+static inline void sim_init(u32 n, LinkConnectionSettings settings, u32 seed) {
+  sim.n = n;
+  sim.random = seed ? seed : 1;
+  sim.interval = settings.interval;
+  for (u32 i = 0; i < n; i++) {
+    sim_select(i);
+    sim.conns[i] = lc_init(settings);
+  }
+}
+
+static inline void sim_activate(void) {
+  for (u32 i = 0; i < sim.n; i++) {
+    sim_select(i);
+    lc_activate(&sim.conns[i]);
+  }
+}
+
+#define SIM_CHECK(CONDITION, ...)                                     \
+  do {                                                                \
+    if (!(CONDITION)) {                                               \
+      fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #CONDITION); \
+      fprintf(stderr, __VA_ARGS__);                                   \
+      fprintf(stderr, "\n");                                          \
+      exit(1);                                                        \
+    }                                                                 \
+  } while (0)
+
+#endif  // LINK_SIM_H
@@ -0,0 +1,76 @@
+/*
+test_auto_baud - With LINK_ENABLE_AUTO_BAUD, the master tries faster rates on a
+clean link, but console 2 misses every announcement. The others must fall back
+to the rate it kept after LINK_BAUD_FALLBACK_ERRORS failed transfers, without
+resetting the session, and try again later. Once it hears them, everyone must
+reach the highest rate.
+
+Usage:
+
+  test_auto_baud
+*/
+
+#define LINK_ENABLE_AUTO_BAUD
+#define LINK_ENABLE_EVENTS
+#define LINK_ENABLE_STATS
+#include "link_sim.h"
+
+#define CONSOLES 3
+#define TICKS 20000
+
+static bool is_announcement(u32 console, const u16 *words) {
+  return console == 2 && words[0] >= LINK_CTRL(LINK_OP_SYNC, LINK_SYNC_BAUD) &&
+         words[0] <= LINK_CTRL(LINK_OP_SYNC, LINK_SYNC_BAUD + BAUD_RATE_3);
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_3,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .soft_resets = 8,
+    .buffer_len = 16,
+    .interval = 20,
+    .send_timer_id = 3,
+  };
+  sim_init(CONSOLES, settings, 50);
+  sim_activate();
+  sim.drop = is_announcement;
+
+  u32 switches = 0, fallbacks = 0;
+  for (u32 tick = 0; tick < TICKS; tick++) {
+    u8 rate = lc_baud_rate(&sim.conns[0]);
+    sim_timer();
+    if (tick % 4 == 0) {
+      sim_vblank();
+    }
+    sim_select(0);
+    LinkEvent event;
+    while (lc_next_event(&sim.conns[0], &event)) {
+      SIM_CHECK(event.type != LINK_EVENT_RESET, "reset at tick %u", tick);
+      if (event.type == LINK_EVENT_BAUD) {
+        event.detail > rate ? switches++ : fallbacks++;
+        rate = event.detail;
+      }
+    }
+  }
+
+  SIM_CHECK(switches > 1 && fallbacks == switches, "%u switches, %u fallbacks", switches, fallbacks);
+  for (u32 i = 0; i < CONSOLES; i++) {
+    LinkStats stats;
+    lc_get_stats(&sim.conns[i], &stats);
+    SIM_CHECK(stats.resets_error + stats.resets_timeout == 0, "console %u reset", i);
+    SIM_CHECK(lc_baud_rate(&sim.conns[i]) == BAUD_RATE_0, "console %u is at rate %u", i, lc_baud_rate(&sim.conns[i]));
+  }
+
+  sim.drop = NULL;
+  u32 ticks = 0;
+  for (; ticks < TICKS * 10 && lc_baud_rate(&sim.conns[2]) != BAUD_RATE_3; ticks++) {
+    sim_run(4, 4);
+  }
+  for (u32 i = 0; i < CONSOLES; i++) {
+    SIM_CHECK(lc_baud_rate(&sim.conns[i]) == BAUD_RATE_3, "console %u is at rate %u", i, lc_baud_rate(&sim.conns[i]));
+  }
+  printf("test_auto_baud: %u switches undone without a reset, then the top rate after %u frames\n", switches, ticks);
+  return 0;
+}
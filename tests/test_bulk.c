@@ -0,0 +1,94 @@
+/*
+test_bulk - The master sends an odd-sized blob to two slaves through random
+transfer errors with LINK_ENABLE_BULK, and a message in the middle of it.
+Both must get every byte, progress must only go forward, and the send timer
+must get its normal `interval` back at the end.
+
+Usage:
+
+  test_bulk
+*/
+
+#define LINK_ENABLE_BULK
+#include "link_sim.h"
+
+#define CONSOLES 3
+#define BLOB_LEN 1001
+#define MAX_FRAMES 2000
+
+static u8 blob[BLOB_LEN];
+static u8 received[CONSOLES][BLOB_LEN + 16];
+static u32 progress[CONSOLES][LINK_MAX_PLAYERS];
+
+static void on_progress(void *context, u8 player_id, u32 done, u32 total) {
+  u32 console = (u32)(size_t)context;
+  SIM_CHECK(done >= progress[console][player_id], "console %u: progress went back to %u", console, done);
+  SIM_CHECK(total == 0 || (total == BLOB_LEN && done <= total), "console %u: %u of %u", console, done, total);
+  progress[console][player_id] = done;
+}
+
+int main(void) {
+  for (u32 i = 0; i < BLOB_LEN; i++) {
+    blob[i] = i * 37 + (i >> 8);
+  }
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .soft_resets = 8,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(CONSOLES, settings, 38);
+  sim_activate();
+  sim_run(20, 4);
+
+  for (u32 i = 1; i < CONSOLES; i++) {
+    sim_select(i);
+    SIM_CHECK(lc_bulk_receive(&sim.conns[i], 0, received[i], sizeof(received[i])), "console %u can't receive", i);
+  }
+  sim_select(0);
+  SIM_CHECK(lc_bulk_send(&sim.conns[0], blob, BLOB_LEN), "can't send");
+  SIM_CHECK(!lc_bulk_send(&sim.conns[0], blob, BLOB_LEN), "a second send started");
+  SIM_CHECK(sim.conns[0].interval < settings.interval, "the timer isn't faster");
+
+  sim.error_rate = 1500;
+  u32 frames = 0;
+  bool active = true;
+  for (; active && frames < MAX_FRAMES; frames++) {
+    if (frames == 10) {
+      sim_select(0);
+      lc_send(&sim.conns[0], 0x4242);
+    }
+    sim_run(4, 4);
+    active = false;
+    for (u32 i = 0; i < CONSOLES; i++) {
+      sim_select(i);
+      active |= lc_bulk_update(&sim.conns[i], on_progress, (void *)(size_t)i);
+    }
+  }
+
+  sim_select(0);
+  SIM_CHECK(lc_bulk_send_status(&sim.conns[0]) == LINK_BULK_DONE, "send status %u after %u frames",
+            lc_bulk_send_status(&sim.conns[0]), frames);
+  SIM_CHECK(sim.conns[0].interval == settings.interval, "interval %u", sim.conns[0].interval);
+  SIM_CHECK(sim.conns[0].bulk_resent > 0, "no chunk was sent again");
+  for (u32 i = 1; i < CONSOLES; i++) {
+    sim_select(i);
+    SIM_CHECK(lc_bulk_receive_status(&sim.conns[i], 0) == LINK_BULK_DONE, "console %u: receive status %u", i,
+              lc_bulk_receive_status(&sim.conns[i], 0));
+    SIM_CHECK(lc_bulk_received(&sim.conns[i], 0) == BLOB_LEN && progress[i][0] == BLOB_LEN, "console %u got %u bytes",
+              i, lc_bulk_received(&sim.conns[i], 0));
+    for (u32 j = 0; j < BLOB_LEN; j++) {
+      SIM_CHECK(received[i][j] == blob[j], "console %u, byte %u: 0x%02x, expected 0x%02x", i, j, received[i][j], blob[j]);
+    }
+    SIM_CHECK(received[i][BLOB_LEN] == 0, "console %u wrote past the blob", i);
+    SIM_CHECK(sim.conns[i].interval == settings.interval, "console %u: interval %u", i, sim.conns[i].interval);
+  }
+  sim_select(2);
+  SIM_CHECK(lc_read_message(&sim.conns[2], 0) == 0x4242, "the message didn't arrive");
+
+  printf("test_bulk: %u bytes in %u frames, %u chunks sent again\n", BLOB_LEN, frames, sim.conns[0].bulk_resent);
+  return 0;
+}
@@ -0,0 +1,67 @@
+/*
+test_bytes - The master sends an odd number of bytes with LINK_ENABLE_BYTES,
+including pairs that look like 0x0000, 0xFFFF and control words, and a message
+in the middle. The slave must read the same bytes in order, and the message
+as a message, while the bytes take about half as many transfers.
+
+Usage:
+
+  test_bytes
+*/
+
+#define LINK_ENABLE_BYTES
+#define LINK_ENABLE_STATS
+#include "link_sim.h"
+
+#define COUNT 41
+
+static u8 byte(u32 i) {
+  static const u8 special[] = {0x00, 0x00, 0xFF, 0xFF, 0xFE, 0x12, 0xFF, 0x00};
+  return i < sizeof(special) ? special[i] : i * 7;
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(2, settings, 41);
+  sim_activate();
+  sim_run(20, 4);
+  lc_reset_stats(&sim.conns[0]);
+
+  sim_select(0);
+  for (u32 i = 0; i < COUNT; i++) {
+    SIM_CHECK(lc_send_byte(&sim.conns[0], byte(i)), "byte %u didn't fit", i);
+    if (i == COUNT / 2) {
+      lc_send(&sim.conns[0], 0x1234);
+    }
+  }
+  sim_run(40, 4);
+
+  // One BYTES word per run of 32 bytes, and an escape for each of the 4 special pairs,
+  // plus the message and a few control words of reliable delivery.
+  LinkStats stats;
+  lc_get_stats(&sim.conns[0], &stats);
+  u32 expected = (COUNT + 1) / 2 + (COUNT + 31) / 32 + 4 + 1;
+  SIM_CHECK(stats.words_sent >= expected && stats.words_sent <= expected + 4, "%u words sent, expected %u",
+            stats.words_sent, expected);
+
+  sim_select(1);
+  SIM_CHECK(lc_bytes_available(&sim.conns[1], 0) == COUNT, "%u bytes arrived", lc_bytes_available(&sim.conns[1], 0));
+  u8 value = 0;
+  for (u32 i = 0; i < COUNT; i++) {
+    SIM_CHECK(lc_read_byte(&sim.conns[1], 0, &value) && value == byte(i), "byte %u is 0x%02x, expected 0x%02x", i,
+              value, byte(i));
+  }
+  SIM_CHECK(!lc_read_byte(&sim.conns[1], 0, &value), "extra bytes arrived");
+  SIM_CHECK(lc_read_message(&sim.conns[1], 0) == 0x1234, "the message didn't arrive");
+  SIM_CHECK(lc_read_message(&sim.conns[1], 0) == LINK_NO_DATA, "bytes arrived as messages");
+
+  printf("test_bytes: %u bytes in %u words\n", COUNT, stats.words_sent - 1);
+  return 0;
+}
@@ -0,0 +1,101 @@
+/*
+test_callbacks - Two slaves get the master's messages and the connection events
+through LINK_ENABLE_CALLBACKS: console 1 from `lc_dispatch`, console 2 straight
+from the IRQ handlers. Both must see every message once and in order, the
+other slave leave, and the reset when the link goes quiet.
+
+Usage:
+
+  test_callbacks
+*/
+
+#define LINK_ENABLE_CALLBACKS
+#include "link_sim.h"
+
+#define CONSOLES 3
+#define MESSAGES 50
+
+typedef struct Seen {
+  u32 messages, events, resets;
+  u8 connected;                 // Bitmask of the players reported as connected
+  u8 reset_reason;
+} Seen;
+
+static Seen seen[CONSOLES];
+
+static void on_message(void *context, u8 player_id, u16 message) {
+  Seen *s = context;
+  SIM_CHECK(player_id == 0 && message == 100 + s->messages, "console %u got 0x%04x from %u after #%u",
+            (u32)(s - seen), message, player_id, s->messages);
+  s->messages++;
+}
+static void on_connected(void *context, u8 player_id) {
+  ((Seen *)context)->connected |= 1 << player_id;
+}
+static void on_disconnected(void *context, u8 player_id) {
+  ((Seen *)context)->connected &= ~(1 << player_id);
+}
+static void on_reset(void *context, u8 reason) {
+  ((Seen *)context)->resets++;
+  ((Seen *)context)->reset_reason = reason;
+}
+static void on_event(void *context, const LinkEvent *event) {
+  ((Seen *)context)->events++;
+}
+
+static void dispatch(void) {
+  sim_select(1);
+  lc_dispatch(&sim.conns[1]);
+  sim_select(2);
+  SIM_CHECK(lc_dispatch(&sim.conns[2]) == 0, "lc_dispatch reported calls made from the IRQs");
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(CONSOLES, settings, 45);
+  for (u32 i = 1; i < CONSOLES; i++) {
+    LinkCallbacks callbacks = {on_message, on_connected, on_disconnected, on_reset, on_event, &seen[i], i == 2};
+    sim_select(i);
+    lc_set_callbacks(&sim.conns[i], callbacks);
+  }
+  sim_activate();
+  sim_run(20, 4);
+
+  for (u32 i = 0; i < MESSAGES; i++) {
+    sim_select(0);
+    lc_send(&sim.conns[0], 100 + i);
+    sim_run(4, 4);
+    dispatch();
+  }
+  sim_run(8, 4);
+  dispatch();
+  for (u32 i = 1; i < CONSOLES; i++) {
+    SIM_CHECK(seen[i].messages == MESSAGES, "console %u got %u messages", i, seen[i].messages);
+    SIM_CHECK(seen[i].connected == 0b101 || seen[i].connected == 0b011, "console %u: players 0x%x", i,
+              seen[i].connected);
+    SIM_CHECK(!lc_has_message(&sim.conns[i], 0), "console %u: messages left in the queue", i);
+  }
+
+  // Console 2 unplugs, then the link goes quiet for `timeout` frames.
+  sim.n = 2;
+  sim_run(4 * (settings.remote_timeout + 2), 4);
+  dispatch();
+  SIM_CHECK(seen[1].connected == 0b001, "console 1: players 0x%x", seen[1].connected);
+  for (u32 i = 0; i <= settings.timeout; i++) {
+    sim_vblank();
+  }
+  sim_timer();
+  dispatch();
+  SIM_CHECK(seen[1].resets == 1 && seen[1].reset_reason == LINK_RESET_TIMEOUT, "console 1: %u resets, reason %u",
+            seen[1].resets, seen[1].reset_reason);
+
+  printf("test_callbacks: %u messages, %u and %u events\n", MESSAGES, seen[1].events, seen[2].events);
+  return 0;
+}
@@ -0,0 +1,75 @@
+/*
+test_channels - The master sends on three channels to two slaves through random
+transfer errors, without LINK_ENABLE_RELIABLE. Words can be lost, but every one
+that arrives must be on the channel it was sent on, and in order.
+
+Usage:
+
+  test_channels
+*/
+
+#define LINK_ENABLE_CHANNELS
+#define LINK_ENABLE_STATS
+#include "link_sim.h"
+
+#define CONSOLES 3
+#define USED_CHANNELS 3
+#define FRAMES 400
+
+// The channel goes in the top bits, so a word on the wrong one shows.
+static u16 message(u32 channel, u32 n) {
+  return (channel + 1) << 12 | (n & 0xFFF);
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .soft_resets = 8,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(CONSOLES, settings, 43);
+  sim_activate();
+  sim_run(20, 4);
+  sim.error_rate = 2000;
+
+  u32 sent[USED_CHANNELS] = {}, next[CONSOLES][USED_CHANNELS] = {}, received = 0;
+  for (u32 frame = 0; frame < FRAMES; frame++) {
+    sim_select(0);
+    // Channel 0 every other frame, so the others get some transfers too.
+    for (u32 c = frame % 2; c < USED_CHANNELS; c++) {
+      if (lc_channel_send(&sim.conns[0], c, message(c, sent[c]))) {
+        sent[c]++;
+      }
+    }
+    sim_run(4, 4);
+    for (u32 i = 1; i < CONSOLES; i++) {
+      sim_select(i);
+      for (u32 c = 0; c < USED_CHANNELS; c++) {
+        u16 value;
+        while ((value = lc_channel_read(&sim.conns[i], c, 0)) != LINK_NO_DATA) {
+          SIM_CHECK(value >> 12 == c + 1, "console %u got 0x%04x on channel %u", i, value, c);
+          SIM_CHECK((value & 0xFFF) >= next[i][c], "console %u got 0x%04x on channel %u after #%u", i, value, c,
+                    next[i][c]);
+          next[i][c] = (value & 0xFFF) + 1;
+          received++;
+        }
+      }
+    }
+  }
+
+  LinkStats stats;
+  lc_get_stats(&sim.conns[1], &stats);
+  SIM_CHECK(stats.transfer_errors > 10, "%u transfer errors", stats.transfer_errors);
+  for (u32 c = 0; c < USED_CHANNELS; c++) {
+    SIM_CHECK(next[1][c] > sent[c] / 2 && next[2][c] > sent[c] / 2, "channel %u: %u and %u of %u arrived", c,
+              next[1][c], next[2][c], sent[c]);
+  }
+
+  printf("test_channels: %u of %u words through %u transfer errors\n", received, (sent[0] + sent[1] + sent[2]) * 2,
+         stats.transfer_errors);
+  return 0;
+}
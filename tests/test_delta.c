@@ -0,0 +1,72 @@
+/*
+test_delta - Three consoles with LINK_ENABLE_DELTA: the master sends the same
+value every frame, which must go out only once every `delta_refresh` calls,
+and then a new one, which must go out right away. `lc_held_value` must follow
+what arrives, and forget a player that disconnects.
+
+Usage:
+
+  test_delta
+*/
+
+#define LINK_ENABLE_DELTA
+#define LINK_ENABLE_STATS
+#include "link_sim.h"
+
+#define REFRESH 5
+#define CALLS 20
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+    .delta_refresh = REFRESH,
+  };
+  sim_init(3, settings, 40);
+  sim_activate();
+  sim_run(20, 4);
+  sim_select(2);
+  lc_send(&sim.conns[2], 0x22);
+
+  for (u32 i = 0; i < CALLS; i++) {
+    sim_select(0);
+    SIM_CHECK(lc_send(&sim.conns[0], 0x10), "call %u failed", i);
+    sim_run(4, 4);
+  }
+  u32 before = lc_frame(&sim.conns[1]);
+  sim_select(0);
+  lc_send(&sim.conns[0], 0x11);
+  sim_run(8, 4);
+
+  LinkStats stats;
+  lc_get_stats(&sim.conns[0], &stats);
+  SIM_CHECK(stats.sends_suppressed == CALLS - CALLS / REFRESH, "%u sends suppressed", stats.sends_suppressed);
+  sim_select(1);
+  for (u32 i = 0; i < CALLS / REFRESH; i++) {
+    u16 value = lc_read_message(&sim.conns[1], 0);
+    SIM_CHECK(value == 0x10, "message %u is 0x%04x", i, value);
+  }
+  SIM_CHECK(lc_read_message(&sim.conns[1], 0) == 0x11, "the new value didn't arrive");
+  SIM_CHECK(lc_read_message(&sim.conns[1], 0) == LINK_NO_DATA, "extra messages arrived");
+
+  // Read or not, the held value stays.
+  u32 since;
+  SIM_CHECK(lc_held_value(&sim.conns[1], 0, &since) == 0x11, "held 0x%04x", lc_held_value(&sim.conns[1], 0, NULL));
+  SIM_CHECK(since >= before && since <= lc_frame(&sim.conns[1]), "changed on frame %u, sent on %u", since, before);
+  SIM_CHECK(lc_held_value(&sim.conns[1], 2, NULL) == 0x22, "player 2 held 0x%04x",
+            lc_held_value(&sim.conns[1], 2, NULL));
+
+  // Console 2 unplugs.
+  sim.n = 2;
+  sim_run(4 * (settings.remote_timeout + 2), 4);
+  SIM_CHECK(lc_held_value(&sim.conns[1], 2, NULL) == LINK_NO_DATA, "player 2 still holds 0x%04x",
+            lc_held_value(&sim.conns[1], 2, NULL));
+  SIM_CHECK(lc_held_value(&sim.conns[1], 0, NULL) == 0x11, "player 0 lost its value");
+
+  printf("test_delta: %u calls, %u sent\n", CALLS, CALLS - stats.sends_suppressed);
+  return 0;
+}
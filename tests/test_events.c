@@ -0,0 +1,85 @@
+/*
+test_events - Console 1 of three reads its LINK_ENABLE_EVENTS queue: its role and
+id once connected, the others joining, a reset by transfer errors, console 2
+leaving, and then more events than the queue holds, of which only the last
+LINK_EVENT_BUFFER_LEN must remain.
+
+Usage:
+
+  test_events
+*/
+
+#define LINK_ENABLE_EVENTS
+#include "link_sim.h"
+
+#define CONSOLES 3
+
+static u32 failing = 0;
+
+static bool fail(u32 console, const u16 *words) {
+  return console == 1 && failing > 0 && failing-- > 0;
+}
+
+// Reads every event, checks their frames, and returns a bit for each (type, player_id) seen.
+static u32 drain(u32 *count, u8 *reset_reason) {
+  u32 seen = 0, frame = 0;
+  LinkEvent event;
+  for (*count = 0; lc_next_event(&sim.conns[1], &event); (*count)++) {
+    SIM_CHECK(event.frame >= frame && event.frame <= lc_frame(&sim.conns[1]), "event %u on frame %u", event.type,
+              event.frame);
+    frame = event.frame;
+    seen |= 1 << (event.type * LINK_MAX_PLAYERS + event.player_id);
+    if (event.type == LINK_EVENT_ROLE) {
+      SIM_CHECK(!event.detail, "console 1 became the master");
+    } else if (event.type == LINK_EVENT_RESET) {
+      *reset_reason = event.detail;
+    }
+  }
+  return seen;
+}
+#define EVENT(TYPE, PLAYER) (1 << ((TYPE) * LINK_MAX_PLAYERS + (PLAYER)))
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .soft_resets = 2,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(CONSOLES, settings, 46);
+  sim_activate();
+  sim_run(20, 4);
+  u32 count;
+  u8 reason = 0xFF;
+  u32 connected = EVENT(LINK_EVENT_ROLE, 1) | EVENT(LINK_EVENT_PLAYER_ID, 1) | EVENT(LINK_EVENT_JOINED, 0) |
+                  EVENT(LINK_EVENT_JOINED, 2);
+  u32 seen = drain(&count, &reason);
+  SIM_CHECK(seen == connected && count == 4, "%u events: 0x%x", count, seen);
+
+  sim.drop = fail;
+  failing = settings.soft_resets + 1;
+  sim_run(20, 4);
+  seen = drain(&count, &reason);
+  SIM_CHECK(seen == (EVENT(LINK_EVENT_RESET, 0) | connected) && reason == LINK_RESET_ERROR, "%u events: 0x%x", count,
+            seen);
+
+  sim.n = 2;
+  sim_run(4 * (settings.remote_timeout + 2), 4);
+  seen = drain(&count, &reason);
+  SIM_CHECK(seen == EVENT(LINK_EVENT_LEFT, 2) && count == 1, "%u events: 0x%x", count, seen);
+
+  // Four resets without reading: 16 events, half of them dropped.
+  for (u32 i = 0; i < 4; i++) {
+    failing = settings.soft_resets + 1;
+    sim_run(20, 4);
+  }
+  drain(&count, &reason);
+  SIM_CHECK(count == LINK_EVENT_BUFFER_LEN && sim.conns[1].events_dropped == 16 - LINK_EVENT_BUFFER_LEN,
+            "%u events read, %u dropped", count, sim.conns[1].events_dropped);
+
+  printf("test_events: %u events dropped\n", sim.conns[1].events_dropped);
+  return 0;
+}
@@ -0,0 +1,70 @@
+/*
+test_lock - With LINK_LOCK_MODE = LINK_LOCK_IE, a lock must mask only the serial
+and send timer IRQs (the scheduler's timer, with a LinkScheduler), leave VBlank
+and the game's other IRQs alone, and give REG_IE back as it was. A VBlank
+during the lock must be skipped, and the link must keep working after it.
+
+Usage:
+
+  test_lock
+*/
+
+#define LINK_LOCK_MODE LINK_LOCK_IE
+#define LINK_ENABLE_STATS
+#include "link_sim.h"
+
+#define SOUND_IRQ IRQ_TIMER0
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  LinkScheduler wheel = lc_scheduler_init(2, 25);
+  settings.scheduler = &wheel;
+  LinkConnection scheduled = lc_init(settings);
+  SIM_CHECK(scheduled.state.irq_mask == (IRQ_SERIAL | IRQ_TIMER2), "scheduler mask 0x%04x",
+            scheduled.state.irq_mask);
+  lc_destroy(&scheduled);
+  settings.scheduler = NULL;
+
+  sim_init(2, settings, 48);
+  sim_activate();
+  sim_run(20, 4);
+  LinkConnection *conn = &sim.conns[1];
+  SIM_CHECK(conn->state.irq_mask == (IRQ_SERIAL | IRQ_TIMER3), "mask 0x%04x", conn->state.irq_mask);
+
+  const u16 enabled[] = {IRQ_VBLANK | IRQ_SERIAL | IRQ_TIMER3 | SOUND_IRQ, IRQ_VBLANK | IRQ_TIMER3};
+  for (u32 i = 0; i < 2; i++) {
+    sim_select(1);
+    REG_IME = 1;
+    REG_IE = enabled[i];
+    lc_reset_stats(conn);
+    {
+      LINK_LOCK(&conn->state);
+      SIM_CHECK(REG_IE == (enabled[i] & (IRQ_VBLANK | SOUND_IRQ)) && REG_IME == 1, "locked: IE 0x%04x, IME %u", REG_IE,
+                REG_IME);
+      u32 frame = lc_frame(conn);
+      sim_vblank();
+      sim_select(1);
+      SIM_CHECK(lc_frame(conn) == frame + 1 && conn->stats.locked_skips == 1, "VBlank: frame %u, %u skips",
+                lc_frame(conn), conn->stats.locked_skips);
+      LINK_UNLOCK(&conn->state);
+    }
+    SIM_CHECK(REG_IE == enabled[i] && REG_IME == 1 && !conn->state.is_locked, "unlocked: IE 0x%04x, IME %u", REG_IE,
+              REG_IME);
+  }
+
+  sim_select(0);
+  lc_send(&sim.conns[0], 0x4848);
+  sim_run(8, 4);
+  sim_select(1);
+  SIM_CHECK(lc_read_message(conn, 0) == 0x4848, "the message didn't arrive");
+
+  printf("test_lock: IE mask 0x%04x\n", conn->state.irq_mask);
+  return 0;
+}
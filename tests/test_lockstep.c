@@ -0,0 +1,78 @@
+/*
+test_lockstep - Three consoles run LinkLockstep with input delay, including a
+console that falls behind for a while, and must all see the same inputs for
+every frame.
+
+Usage:
+
+  test_lockstep
+*/
+
+#define LINK_ENABLE_LOCKSTEP
+#include "link_sim.h"
+
+#define CONSOLES 3
+#define DELAY 2
+#define FRAMES 120
+#define LATE_START 50   // Console 2 doesn't submit anything for LATE_FRAMES frames
+#define LATE_FRAMES 6
+
+static u16 input(u32 console, u32 frame) {
+  return (console * 97 + frame * 13) & LINK_LOCKSTEP_INPUT_MASK;
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(CONSOLES, settings, 34);
+  sim_activate();
+  sim_run(20, 4);
+
+  LinkLockstep lockstep[CONSOLES];
+  for (u32 i = 0; i < CONSOLES; i++) {
+    lockstep[i] = lc_lockstep_init(&sim.conns[i], DELAY);
+  }
+  // A stray message, dropped by the receivers.
+  sim_select(1);
+  lc_send(&sim.conns[1], 0x1234);
+
+  static u16 seen[CONSOLES][FRAMES + 10][LINK_MAX_PLAYERS];
+  for (u32 vblank = 0; vblank < FRAMES + 10; vblank++) {
+    for (u32 i = 0; i < CONSOLES; i++) {
+      sim_select(i);
+      bool late = i == 2 && vblank >= LATE_START && vblank < LATE_START + LATE_FRAMES;
+      if (!late) {
+        lc_lockstep_submit(&lockstep[i], input(i, lockstep[i].submitted));
+      }
+      if (lockstep[i].frame < FRAMES) {
+        lc_lockstep_inputs(&lockstep[i], lockstep[i].frame, seen[i][lockstep[i].frame]);
+      }
+    }
+    sim_run(4, 4);
+  }
+
+  for (u32 i = 0; i < CONSOLES; i++) {
+    SIM_CHECK(lockstep[i].frame == FRAMES, "console %u is at frame %u", i, lockstep[i].frame);
+    SIM_CHECK(lockstep[i].lost == 0, "console %u lost %u inputs", i, lockstep[i].lost);
+    for (u32 frame = 0; frame < FRAMES; frame++) {
+      for (u32 player = 0; player < LINK_MAX_PLAYERS; player++) {
+        u16 expected = player >= CONSOLES ? LINK_DISCONNECTED : frame < DELAY ? 0 : input(player, frame);
+        SIM_CHECK(seen[i][frame][player] == expected, "console %u, frame %u: player %u's input is 0x%04x, not 0x%04x", i,
+                  frame, player, seen[i][frame][player], expected);
+      }
+    }
+  }
+  // Console 2 can run its own (delayed) frames, the others wait for it.
+  SIM_CHECK(lockstep[0].longest_stall >= LATE_FRAMES - DELAY, "console 0 stalled %u frames", lockstep[0].longest_stall);
+  SIM_CHECK(lockstep[0].dropped == 1 && lockstep[2].dropped == 1, "%u and %u words dropped", lockstep[0].dropped,
+            lockstep[2].dropped);
+
+  printf("test_lockstep: %u frames, longest stall %u\n", FRAMES, lockstep[0].longest_stall);
+  return 0;
+}
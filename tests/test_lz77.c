@@ -0,0 +1,92 @@
+/*
+test_lz77 - Compresses several kinds of data with lc_lz77_compress and decodes
+them back with lc_lz77_decode, a few bytes at a time as if they were arriving.
+The output must match, never use a distance of 1, and bad input must fail.
+
+Usage:
+
+  test_lz77
+*/
+
+#define LINK_ENABLE_LZ77
+#include "link_sim.h"
+
+#include <string.h>
+
+#define MAX_LEN 5000
+
+static LinkLz77Work work;
+static u8 data[MAX_LEN];
+static u8 compressed[MAX_LEN * 2];
+static u8 decoded[MAX_LEN + 1];
+
+// Walks the blocks and returns the shortest back-reference distance (0 if there's none).
+static u32 min_distance(const u8 *in, u32 size, u32 len) {
+  u32 min = 0, i = 4, out = 0;
+  while (out < len && i < size) {
+    u8 flags = in[i++];
+    for (u32 bit = 0; bit < 8 && out < len; bit++, flags <<= 1) {
+      if (flags & 0x80) {
+        u32 distance = (((in[i] & 0xF) << 8) | in[i + 1]) + 1;
+        min = min == 0 || distance < min ? distance : min;
+        out += (in[i] >> 4) + 3;
+        i += 2;
+      } else {
+        out++;
+        i++;
+      }
+    }
+  }
+  return min;
+}
+
+static void round_trip(const char *name, u32 len) {
+  u32 size = lc_lz77_compress(data, len, compressed, sizeof(compressed), &work);
+  SIM_CHECK(size > 0 && size % 4 == 0, "%s: compressed to %u bytes", name, size);
+  SIM_CHECK(lc_lz77_compress(data, len, compressed, size - 1, &work) == 0, "%s: fit in less than %u bytes", name, size);
+  lc_lz77_compress(data, len, compressed, sizeof(compressed), &work);
+  u32 distance = min_distance(compressed, size, len);
+  SIM_CHECK(distance != 1, "%s: used distance 1", name);
+
+  memset(decoded, 0xEE, sizeof(decoded));
+  LinkLz77Decoder decoder = lc_lz77_decoder_init(decoded, len);
+  u32 available = 0, calls = 0;
+  u8 status;
+  while ((status = lc_lz77_decode(&decoder, compressed, available, 64)) != LINK_LZ77_DONE) {
+    SIM_CHECK(status != LINK_LZ77_ERROR && calls++ < 100000, "%s: status %u at %u bytes", name, status, decoder.out);
+    if (status == LINK_LZ77_NEED_INPUT) {
+      available = available + 7 < size ? available + 7 : size;
+    }
+  }
+  SIM_CHECK(decoder.out == len && memcmp(decoded, data, len) == 0, "%s: decoded %u bytes that don't match", name,
+            decoder.out);
+  SIM_CHECK(decoded[len] == 0xEE, "%s: wrote past the end", name);
+  printf("test_lz77: %s, %u -> %u bytes\n", name, len, size);
+}
+
+int main(void) {
+  round_trip("empty", 0);
+  for (u32 i = 0; i < MAX_LEN; i++) {
+    data[i] = 0x5A;
+  }
+  round_trip("one byte repeated", MAX_LEN);
+  for (u32 i = 0; i < MAX_LEN; i++) {
+    data[i] = "tile map, palette, "[i % 19] + (i / 700);
+  }
+  round_trip("repeated text", MAX_LEN);
+  sim.random = 39;
+  for (u32 i = 0; i < MAX_LEN; i++) {
+    data[i] = sim_random();
+  }
+  round_trip("random", MAX_LEN);
+  round_trip("odd length", 1001);
+
+  // A header with the wrong type, and a blob too big for the output.
+  u32 size = lc_lz77_compress(data, 100, compressed, sizeof(compressed), &work);
+  LinkLz77Decoder small = lc_lz77_decoder_init(decoded, 99);
+  SIM_CHECK(lc_lz77_decode(&small, compressed, size, 1000) == LINK_LZ77_ERROR, "decoded into a smaller buffer");
+  compressed[0] = 0x11;
+  LinkLz77Decoder bad = lc_lz77_decoder_init(decoded, 100);
+  SIM_CHECK(lc_lz77_decode(&bad, compressed, size, 1000) == LINK_LZ77_ERROR, "decoded a bad header");
+  return 0;
+}
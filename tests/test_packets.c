@@ -0,0 +1,100 @@
+/*
+test_packets - Checks lc_crc16 against a bitwise CRC-16/CCITT-FALSE, then sends
+packets between two consoles with one word flipped on the way (the CRC must
+catch it) and one transfer error inside another packet. Only whole, intact
+packets may reach the incoming queue.
+
+Usage:
+
+  test_packets
+*/
+
+#define LINK_ENABLE_CRC16
+#include "link_sim.h"
+
+#define PACKETS 10
+#define FLIPPED 3   // Packet with a flipped bit
+#define BROKEN 6    // Packet hit by a transfer error
+
+static u16 reference_crc16(const u16 *words, u32 len) {
+  u16 crc = 0xFFFF;
+  for (u32 i = 0; i < len * 2; i++) {
+    u8 byte = i % 2 == 0 ? words[i / 2] & 0xFF : words[i / 2] >> 8;
+    crc ^= byte << 8;
+    for (u32 bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// Packet `k` has k words; its first word (k * 0x1111) appears nowhere else.
+static u32 packet(u32 k, u16 *words) {
+  for (u32 j = 0; j < k; j++) {
+    words[j] = k * 0x1111 + j * 2;
+  }
+  if (k == 8) {
+    words[1] = 0xFE42;   // Escaped
+  }
+  return k;
+}
+
+static void flip(u32 console, u16 *words) {
+  if (console == 1 && words[0] == FLIPPED * 0x1111 + 2) {
+    words[0] ^= 0x0100;
+  }
+}
+
+static bool broken(u32 console, const u16 *words) {
+  return console == 1 && words[0] == BROKEN * 0x1111 + 4;
+}
+
+int main(void) {
+  u16 words[PACKETS + 1];
+  for (u32 k = 1; k <= PACKETS; k++) {
+    u32 len = packet(k, words);
+    SIM_CHECK(lc_crc16(words, len) == reference_crc16(words, len), "packet %u: CRC 0x%04x", k, lc_crc16(words, len));
+  }
+
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .soft_resets = 8,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(2, settings, 37);
+  sim_activate();
+  sim_run(20, 4);
+  sim.tamper = flip;
+  sim.drop = broken;
+
+  sim_select(0);
+  words[0] = 7;
+  words[1] = LINK_DISCONNECTED;
+  SIM_CHECK(!lc_send_packet(&sim.conns[0], words, 2), "a packet with 0xFFFF was queued");
+  for (u32 k = 1; k <= PACKETS; k++) {
+    u32 len = packet(k, words);
+    sim_select(0);
+    SIM_CHECK(lc_send_packet(&sim.conns[0], words, len), "packet %u wasn't queued", k);
+    sim_run(len + 8, 4);
+
+    sim_select(1);
+    if (k == FLIPPED || k == BROKEN) {
+      SIM_CHECK(!lc_has_message(&sim.conns[1], 0), "words of bad packet %u arrived", k);
+      continue;
+    }
+    for (u32 j = 0; j < len; j++) {
+      u16 value = lc_read_message(&sim.conns[1], 0);
+      SIM_CHECK(value == words[j], "packet %u, word %u: 0x%04x, expected 0x%04x", k, j, value, words[j]);
+    }
+  }
+  SIM_CHECK(lc_read_message(&sim.conns[1], 0) == LINK_NO_DATA, "extra words arrived");
+  SIM_CHECK(sim.conns[1].packets_received == PACKETS - 2, "%u packets received", sim.conns[1].packets_received);
+  SIM_CHECK(sim.conns[1].packets_dropped == 2, "%u packets dropped", sim.conns[1].packets_dropped);
+
+  printf("test_packets: %u packets, 2 dropped\n", PACKETS);
+  return 0;
+}
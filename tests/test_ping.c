@@ -0,0 +1,73 @@
+/*
+test_ping - Pings from the master and from a slave, behind queued messages and
+over an unanswered ping, and checks the round trips that LINK_ENABLE_PING
+measures.
+
+Usage:
+
+  test_ping
+*/
+
+#define LINK_ENABLE_PING
+#include "link_sim.h"
+
+#define TRANSFER (50 * 1024)   // Clock ticks between transfers
+
+static LinkLatency ping(u32 console, u32 player_id, u32 queued) {
+  sim_select(console);
+  for (u32 i = 0; i < queued; i++) {
+    lc_send(&sim.conns[console], 100 + i);
+  }
+  SIM_CHECK(lc_ping(&sim.conns[console]), "console %u can't ping", console);
+  sim_run(queued + 8, 4);
+  LinkLatency latency;
+  lc_get_latency(&sim.conns[console], player_id, &latency);
+  return latency;
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(3, settings, 33);
+  sim_activate();
+  sim_run(20, 4);
+
+  // Out with the next transfer, answered in the one after.
+  LinkLatency idle = ping(0, 1, 0);
+  SIM_CHECK(idle.count == 1 && idle.lost == 0, "%u pongs, %u lost", idle.count, idle.lost);
+  SIM_CHECK(idle.last == 2 * TRANSFER, "%u ticks", idle.last);
+  SIM_CHECK(idle.min == idle.last && idle.max == idle.last && idle.average == idle.last, "min/max/average");
+  SIM_CHECK(idle.histogram[3] == 1, "not in the 7.8ms bucket");
+
+  // Behind 5 messages: 5 more transfers.
+  LinkLatency busy = ping(0, 2, 5);
+  SIM_CHECK(busy.count == 2 && busy.last == 7 * TRANSFER, "%u ticks", busy.last);
+  SIM_CHECK(busy.min == 2 * TRANSFER && busy.max == 7 * TRANSFER, "min %u, max %u", busy.min, busy.max);
+  sim_select(1);
+  SIM_CHECK(lc_read_message(&sim.conns[1], 0) == 100, "the messages before the ping are gone");
+  for (u32 i = 1; i < 5; i++) {
+    lc_read_message(&sim.conns[1], 0);
+  }
+  SIM_CHECK(lc_read_message(&sim.conns[1], 0) == LINK_NO_DATA, "the ping arrived as a message");
+
+  // A slave pings the master and the other slave, one transfer later: its next word is loaded already.
+  LinkLatency slave = ping(1, 0, 0);
+  SIM_CHECK(slave.count == 1 && slave.last == 3 * TRANSFER, "%u pongs, %u ticks", slave.count, slave.last);
+  SIM_CHECK(ping(1, 2, 0).count == 2, "the other slave didn't answer");
+
+  // A ping that replaces an unanswered one counts it as lost, and its late pongs are ignored.
+  sim_select(0);
+  lc_ping(&sim.conns[0]);
+  LinkLatency lost = ping(0, 2, 0);
+  SIM_CHECK(lost.count == 3 && lost.lost == 1, "%u pongs, %u lost", lost.count, lost.lost);
+  SIM_CHECK(lost.last == 3 * TRANSFER, "%u ticks, behind the first ping", lost.last);
+
+  printf("test_ping: %u ticks idle, %u behind 5 messages\n", idle.last, busy.last);
+  return 0;
+}
@@ -0,0 +1,85 @@
+/*
+test_reliable - Three consoles stream messages to each other through random
+transfer errors and a burst of them on one console, with LINK_ENABLE_RELIABLE.
+Every message must arrive once and in order, without a single reset.
+
+Usage:
+
+  test_reliable
+*/
+
+#define LINK_ENABLE_RELIABLE
+#define LINK_ENABLE_STATS
+#include "link_sim.h"
+
+#define CONSOLES 3
+#define TICKS 250
+#define BURST_START 120
+#define BURST_LEN 6
+
+// The i-th message of every console, all over the range (escaped ones included).
+static u16 message(u32 i) {
+  return 1 + (i * 7919) % 0xFFFE;
+}
+
+static bool burst(u32 console, const u16 *words) {
+  return console == 2 && sim.transfers >= BURST_START && sim.transfers < BURST_START + BURST_LEN;
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .soft_resets = 8,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(CONSOLES, settings, 26);
+  sim_activate();
+  sim_run(20, 4);
+
+  sim.error_rate = 3000;
+  sim.drop = burst;
+  u32 sent[CONSOLES] = {}, received[CONSOLES][CONSOLES] = {};
+  for (u32 tick = 0; tick < TICKS + 100; tick++) {
+    if (tick == TICKS) {
+      // Let the retransmissions finish.
+      sim.error_rate = 0;
+    }
+    for (u32 i = 0; i < CONSOLES; i++) {
+      sim_select(i);
+      if (tick < TICKS && lc_send(&sim.conns[i], message(sent[i]))) {
+        sent[i]++;
+      }
+      for (u32 from = 0; from < CONSOLES; from++) {
+        u16 value;
+        while (from != i && (value = lc_read_message(&sim.conns[i], from)) != LINK_NO_DATA) {
+          u32 n = received[i][from]++;
+          SIM_CHECK(value == message(n), "console %u got 0x%04x from %u, expected 0x%04x (#%u)", i, value, from,
+                    message(n), n);
+        }
+      }
+    }
+    sim_timer();
+    if (tick % 4 == 0) {
+      sim_vblank();
+    }
+  }
+
+  u32 errors = 0;
+  for (u32 i = 0; i < CONSOLES; i++) {
+    LinkStats stats;
+    lc_get_stats(&sim.conns[i], &stats);
+    SIM_CHECK(stats.resets_soft + stats.resets_error + stats.resets_timeout == 0, "console %u reset", i);
+    errors += stats.transfer_errors;
+    for (u32 from = 0; from < CONSOLES; from++) {
+      SIM_CHECK(from == i || received[i][from] == sent[from], "console %u got %u of the %u messages from %u", i,
+                received[i][from], sent[from], from);
+    }
+  }
+  SIM_CHECK(errors > BURST_LEN, "no transfer errors");
+  printf("test_reliable: %u messages through %u transfer errors\n", sent[0] + sent[1] + sent[2], errors);
+  return 0;
+}
@@ -0,0 +1,102 @@
+/*
+test_rollback - Two consoles run a small game with LinkRollback, resimulating
+whenever a prediction was wrong, and must end in the state that the real
+inputs give. A normal message that looks like an input must still arrive as
+a message.
+
+Usage:
+
+  test_rollback
+*/
+
+#define LINK_ENABLE_ROLLBACK
+#include "link_sim.h"
+
+#define CONSOLES 2
+#define FRAMES 100
+
+typedef struct Game {
+  LinkRollback rollback;
+  u32 states[FRAMES + 1];   // State before each frame
+} Game;
+
+static Game games[CONSOLES];
+
+// Changes every 7 frames, so predictions (repeat the last input) are sometimes wrong.
+static u16 input(u32 console, u32 frame) {
+  return (console + 1) * (frame / 7 + 1) & LINK_LOCKSTEP_INPUT_MASK;
+}
+
+static u32 step(u32 state, const u16 *inputs) {
+  for (u32 i = 0; i < CONSOLES; i++) {
+    state = state * 31 + inputs[i];
+  }
+  return state;
+}
+
+static void run(Game *game, u32 frame) {
+  u16 inputs[LINK_MAX_PLAYERS];
+  lc_rollback_inputs(&game->rollback, frame, inputs);
+  game->states[frame + 1] = step(game->states[frame], inputs);
+}
+
+static void resimulate(void *context, u32 frame, u32 count) {
+  for (u32 i = 0; i < count; i++) {
+    run(context, frame + i);
+  }
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(CONSOLES, settings, 35);
+  sim_activate();
+  sim_run(20, 4);
+  for (u32 i = 0; i < CONSOLES; i++) {
+    sim_select(i);
+    lc_rollback_init(&games[i].rollback, &sim.conns[i], resimulate, &games[i]);
+  }
+  sim_select(0);
+  lc_send(&sim.conns[0], LINK_LOCKSTEP_WORD(3, 0x55));
+
+  for (u32 vblank = 0; vblank < FRAMES + 20; vblank++) {
+    for (u32 i = 0; i < CONSOLES; i++) {
+      Game *game = &games[i];
+      sim_select(i);
+      lc_rollback_update(&game->rollback);
+      // Console 1 runs at half speed for a while, so console 0 predicts its inputs.
+      bool slow = i == 1 && vblank >= 30 && vblank < 50 && vblank % 2 == 0;
+      if (game->rollback.frame < FRAMES && !slow && lc_rollback_ready(&game->rollback)) {
+        lc_rollback_submit(&game->rollback, input(i, game->rollback.frame));
+        run(game, game->rollback.frame);
+        lc_rollback_advance(&game->rollback);
+      }
+    }
+    sim_run(4, 4);
+  }
+
+  u32 expected = 0;
+  for (u32 frame = 0; frame < FRAMES; frame++) {
+    u16 inputs[CONSOLES] = {input(0, frame), input(1, frame)};
+    expected = step(expected, inputs);
+  }
+  for (u32 i = 0; i < CONSOLES; i++) {
+    LinkRollback *rollback = &games[i].rollback;
+    SIM_CHECK(rollback->frame == FRAMES, "console %u is at frame %u", i, rollback->frame);
+    SIM_CHECK(games[i].states[FRAMES] == expected, "console %u ended in 0x%08x, not 0x%08x", i, games[i].states[FRAMES],
+              expected);
+  }
+  SIM_CHECK(games[0].rollback.rollbacks > 0, "console 0 never rolled back");
+  sim_select(1);
+  SIM_CHECK(lc_read_message(&sim.conns[1], 0) == LINK_LOCKSTEP_WORD(3, 0x55), "the message was taken for an input");
+
+  printf("test_rollback: %u rollbacks, %u frames resimulated\n", games[0].rollback.rollbacks,
+         games[0].rollback.resimulated);
+  return 0;
+}
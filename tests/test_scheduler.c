@@ -0,0 +1,81 @@
+/*
+test_scheduler - Checks the periods of LinkScheduler slots, then runs two
+consoles on a shared scheduler, next to another client, without the link
+touching its own send timer.
+
+Usage:
+
+  test_scheduler
+*/
+
+#include "link_sim.h"
+
+#define TICK 10
+#define TICKS 600
+
+static void count(void *context) {
+  (*(u32 *)context)++;
+}
+
+int main(void) {
+  // 10 ticks, 25 rounded to 30, and 4 to a single tick.
+  LinkScheduler wheel = lc_scheduler_init(LINK_SCHEDULER_EXTERNAL, TICK);
+  u32 calls[LINK_SCHEDULER_SLOTS] = {};
+  SIM_CHECK(lc_scheduler_add(&wheel, 10, count, &calls[0]) == 0, "first slot");
+  SIM_CHECK(lc_scheduler_add(&wheel, 25, count, &calls[1]) == 1, "second slot");
+  SIM_CHECK(lc_scheduler_add(&wheel, 4, count, &calls[2]) == 2, "third slot");
+  for (u32 i = 0; i < 30; i++) {
+    lc_scheduler_on_timer(&wheel);
+  }
+  SIM_CHECK(calls[0] == 30 && calls[1] == 10 && calls[2] == 30, "%u, %u, %u calls", calls[0], calls[1], calls[2]);
+  lc_scheduler_remove(&wheel, 1);
+  lc_scheduler_on_timer(&wheel);
+  lc_scheduler_on_timer(&wheel);
+  lc_scheduler_on_timer(&wheel);
+  SIM_CHECK(calls[1] == 10, "a removed slot was called");
+  SIM_CHECK(lc_scheduler_add(&wheel, 10, count, &calls[3]) == 1, "the removed slot wasn't reused");
+
+  // The link: one transfer every 50 / TICK = 5 ticks.
+  LinkScheduler scheds[2];
+  u32 other[2] = {};
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(2, settings, 28);
+  for (u32 i = 0; i < 2; i++) {
+    scheds[i] = lc_scheduler_init(LINK_SCHEDULER_EXTERNAL, TICK);
+    lc_scheduler_add(&scheds[i], TICK * 3, count, &other[i]);
+    sim.conns[i].scheduler = &scheds[i];
+  }
+  sim_activate();
+
+  u32 sent = 0, received = 0;
+  for (u32 tick = 0; tick < TICKS; tick++) {
+    sim_select(0);
+    if (tick % 10 == 0 && lc_send(&sim.conns[0], 100 + sent)) {
+      sent++;
+    }
+    sim_select(1);
+    u16 value;
+    while ((value = lc_read_message(&sim.conns[1], 0)) != LINK_NO_DATA) {
+      SIM_CHECK(value == 100 + received, "got %u, expected %u", value, 100 + received);
+      received++;
+    }
+    sim_run(1, 20);
+  }
+  SIM_CHECK(sim.transfers == TICKS / 5, "%u transfers in %u ticks", sim.transfers, TICKS);
+  SIM_CHECK(other[0] == TICKS / 3 && other[1] == TICKS / 3, "the other client got %u calls", other[0]);
+  SIM_CHECK(received == sent, "%u of %u messages arrived", received, sent);
+  for (u32 i = 0; i < 2; i++) {
+    sim_select(i);
+    SIM_CHECK(!(REG_TM[3].cnt & TM_ENABLE), "console %u started its send timer", i);
+  }
+
+  printf("test_scheduler: %u transfers, %u messages\n", sim.transfers, received);
+  return 0;
+}
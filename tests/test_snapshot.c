@@ -0,0 +1,64 @@
+/*
+test_snapshot - Three consoles connect, then one unplugs and another one is
+deactivated. Every console's LINK_ENABLE_SNAPSHOT snapshot must match its
+connection state after each step.
+
+Usage:
+
+  test_snapshot
+*/
+
+#define LINK_ENABLE_SNAPSHOT
+#include "link_sim.h"
+
+#define CONSOLES 3
+
+static void check(u32 console, u8 player_count, u8 connected, bool is_connected) {
+  LinkSnapshot snapshot;
+  sim_select(console);
+  lc_snapshot(&sim.conns[console], &snapshot);
+  SIM_CHECK(snapshot.player_count == player_count && snapshot.connected == connected, "console %u: %u players, 0x%x",
+            console, snapshot.player_count, snapshot.connected);
+  SIM_CHECK(snapshot.is_connected == is_connected, "console %u: connected %u", console, snapshot.is_connected);
+  SIM_CHECK(snapshot.is_connected == lc_is_connected(&sim.conns[console]), "console %u: lc_is_connected differs",
+            console);
+  if (is_connected) {
+    SIM_CHECK(snapshot.current_player_id == console && snapshot.is_master == (console == 0),
+              "console %u: id %u, master %u", console, snapshot.current_player_id, snapshot.is_master);
+  }
+  SIM_CHECK(snapshot.frame <= lc_frame(&sim.conns[console]) && snapshot.frame + 1 >= lc_frame(&sim.conns[console]),
+            "console %u: taken on frame %u, now %u", console, snapshot.frame, lc_frame(&sim.conns[console]));
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(CONSOLES, settings, 47);
+  sim_activate();
+  for (u32 i = 0; i < CONSOLES; i++) {
+    check(i, 0, 0, false);
+  }
+  sim_run(20, 4);
+  for (u32 i = 0; i < CONSOLES; i++) {
+    check(i, 3, 0b111, true);
+  }
+
+  // Console 2 unplugs.
+  sim.n = 2;
+  sim_run(4 * (settings.remote_timeout + 2), 4);
+  check(0, 2, 0b011, true);
+  check(1, 2, 0b011, true);
+
+  sim_select(1);
+  lc_deactivate(&sim.conns[1]);
+  check(1, 0, 0, false);
+
+  printf("test_snapshot: %u consoles\n", CONSOLES);
+  return 0;
+}
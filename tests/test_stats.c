@@ -0,0 +1,92 @@
+/*
+test_stats - Checks the LINK_ENABLE_STATS counters against what two consoles
+actually did: messages, rejected and overflowing sends, transfer errors and
+both kinds of resets.
+
+Usage:
+
+  test_stats
+*/
+
+#define LINK_ENABLE_STATS
+#include "link_sim.h"
+
+#define MESSAGES 40
+
+static u32 drops = 0;
+
+static bool drop_two(u32 console, const u16 *words) {
+  return console == 1 && words[0] == 7 && drops++ < 2;
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 16,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(2, settings, 29);
+  sim_activate();
+  sim_run(20, 4);
+  LinkStats stats[2];
+  for (u32 i = 0; i < 2; i++) {
+    lc_reset_stats(&sim.conns[i]);
+  }
+  u32 transfers = sim.transfers;
+
+  // Rejected and overflowing sends: 16 fit, 4 don't, and 0xFFFF is reserved.
+  sim_select(0);
+  SIM_CHECK(!lc_send(&sim.conns[0], LINK_DISCONNECTED), "0xFFFF was queued");
+  for (u32 i = 0; i < 20; i++) {
+    lc_send(&sim.conns[0], 100 + i);
+  }
+  lc_get_stats(&sim.conns[0], &stats[0]);
+  SIM_CHECK(stats[0].send_rejects == 1, "%u rejects", stats[0].send_rejects);
+  SIM_CHECK(stats[0].queue_overflows == 4, "%u overflows", stats[0].queue_overflows);
+  SIM_CHECK(stats[0].outgoing_high_water == 16, "high water %u", stats[0].outgoing_high_water);
+  sim_run(MESSAGES, 4);
+
+  lc_get_stats(&sim.conns[0], &stats[0]);
+  lc_get_stats(&sim.conns[1], &stats[1]);
+  transfers = sim.transfers - transfers;
+  SIM_CHECK(stats[0].transfers == transfers && stats[1].transfers == transfers, "%u and %u of %u transfers",
+            stats[0].transfers, stats[1].transfers, transfers);
+  SIM_CHECK(stats[0].words_sent == 16, "%u words sent", stats[0].words_sent);
+  SIM_CHECK(stats[1].words_received[0] == 16, "%u words received", stats[1].words_received[0]);
+  SIM_CHECK(stats[1].incoming_high_water[0] == 16, "high water %u", stats[1].incoming_high_water[0]);
+
+  // Two transfer errors on console 1, without soft resets: two resets.
+  lc_reset_stats(&sim.conns[0]);
+  lc_reset_stats(&sim.conns[1]);
+  sim.drop = drop_two;
+  sim_select(0);
+  lc_send(&sim.conns[0], 7);
+  sim_run(4, 4);
+  sim_select(0);
+  lc_send(&sim.conns[0], 7);
+  sim_run(20, 4);
+  lc_get_stats(&sim.conns[1], &stats[1]);
+  SIM_CHECK(stats[1].transfer_errors == 2, "%u errors", stats[1].transfer_errors);
+  SIM_CHECK(stats[1].resets_error == 2, "%u resets by errors", stats[1].resets_error);
+  SIM_CHECK(stats[1].resets_timeout == 0, "%u resets by timeouts", stats[1].resets_timeout);
+
+  // No transfers for `timeout` frames.
+  for (u32 i = 0; i <= settings.timeout; i++) {
+    sim_vblank();
+  }
+  sim_timer();
+  for (u32 i = 0; i < 2; i++) {
+    lc_get_stats(&sim.conns[i], &stats[i]);
+    SIM_CHECK(stats[i].resets_timeout == 1, "console %u: %u resets by timeouts", i, stats[i].resets_timeout);
+  }
+
+  lc_reset_stats(&sim.conns[1]);
+  lc_get_stats(&sim.conns[1], &stats[1]);
+  SIM_CHECK(stats[1].transfers == 0 && stats[1].resets_timeout == 0, "lc_reset_stats left counters");
+
+  printf("test_stats: %u transfers\n", sim.transfers);
+  return 0;
+}
@@ -0,0 +1,83 @@
+/*
+test_stream - Three consoles with LINK_ENABLE_BYTES exchange byte streams
+through random transfer errors: the master writes to both slaves, and a slave
+writes back, a few odd-sized chunks per frame. Every byte must arrive, in
+order, with none dropped.
+
+Usage:
+
+  test_stream
+*/
+
+#define LINK_ENABLE_BYTES
+#include "link_sim.h"
+
+#define CONSOLES 3
+#define STREAM_LEN 600
+#define MAX_FRAMES 2000
+
+static u8 stream[2][STREAM_LEN];
+static u32 written[2];
+static u8 received[CONSOLES][2][STREAM_LEN];
+static u32 read[CONSOLES][2];
+
+int main(void) {
+  for (u32 i = 0; i < STREAM_LEN; i++) {
+    stream[0][i] = i * 13 + (i >> 7);
+    stream[1][i] = i % 5 == 0 ? 0xFF : i * 29;
+  }
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .soft_resets = 8,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(CONSOLES, settings, 42);
+  sim_activate();
+  sim_run(20, 4);
+  sim.error_rate = 2000;
+
+  // Stream 0 goes from the master to both slaves, stream 1 from console 1 to the others.
+  u32 senders[2] = {0, 1};
+  u32 frames = 0;
+  for (; frames < MAX_FRAMES && (read[1][0] < STREAM_LEN || read[2][0] < STREAM_LEN || read[0][1] < STREAM_LEN ||
+                                 read[2][1] < STREAM_LEN);
+       frames++) {
+    for (u32 s = 0; s < 2; s++) {
+      sim_select(senders[s]);
+      u32 len = STREAM_LEN - written[s] < 7 + frames % 5 ? STREAM_LEN - written[s] : 7 + frames % 5;
+      written[s] += lc_write(&sim.conns[senders[s]], stream[s] + written[s], len);
+    }
+    sim_run(4, 4);
+    for (u32 i = 0; i < CONSOLES; i++) {
+      sim_select(i);
+      for (u32 s = 0; s < 2; s++) {
+        if (i != senders[s]) {
+          read[i][s] += lc_read(&sim.conns[i], senders[s], received[i][s] + read[i][s], STREAM_LEN - read[i][s]);
+        }
+      }
+    }
+  }
+
+  for (u32 i = 0; i < CONSOLES; i++) {
+    for (u32 s = 0; s < 2; s++) {
+      if (i == senders[s]) {
+        continue;
+      }
+      SIM_CHECK(read[i][s] == STREAM_LEN, "console %u got %u bytes of stream %u", i, read[i][s], s);
+      for (u32 j = 0; j < STREAM_LEN; j++) {
+        SIM_CHECK(received[i][s][j] == stream[s][j], "console %u, stream %u, byte %u: 0x%02x, expected 0x%02x", i, s,
+                  j, received[i][s][j], stream[s][j]);
+      }
+    }
+    SIM_CHECK(sim.conns[i].bytes_dropped == 0, "console %u dropped %u bytes", i, sim.conns[i].bytes_dropped);
+    SIM_CHECK(lc_read_message(&sim.conns[i], 0) == LINK_NO_DATA && lc_read_message(&sim.conns[i], 1) == LINK_NO_DATA,
+              "console %u: bytes arrived as messages", i);
+  }
+
+  printf("test_stream: 2 streams of %u bytes in %u frames\n", STREAM_LEN, frames);
+  return 0;
+}
@@ -0,0 +1,62 @@
+/*
+test_timeouts - With LINK_ENABLE_TIMEOUT_US, and frame and transfer timeouts
+far too long to matter: a console that unplugs must be marked as disconnected
+after `remote_timeout_us`, and a slave that stops getting transfers must reset
+after `timeout_us`, without a single VBlank.
+
+Usage:
+
+  test_timeouts
+*/
+
+#define LINK_ENABLE_TIMEOUT_US
+#define LINK_ENABLE_STATS
+#include "link_sim.h"
+
+#define TICK_US 3052   // 50 * 1024 cycles
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 30,
+    .remote_timeout = 50,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+    .timeout_us = 20000,
+    .remote_timeout_us = 15000,
+  };
+  sim_init(3, settings, 49);
+  sim_activate();
+  sim_run(20, 4);
+  for (u32 i = 0; i < 3; i++) {
+    SIM_CHECK(sim.conns[i].state.player_count == 3, "console %u: %u players", i, sim.conns[i].state.player_count);
+  }
+
+  // Console 2 unplugs: 15 ms is a bit less than 5 transfers.
+  sim.n = 2;
+  u32 ticks = 0;
+  for (; ticks < settings.remote_timeout && sim.conns[1].state.player_count == 3; ticks++) {
+    sim_timer();
+  }
+  SIM_CHECK(ticks == settings.remote_timeout_us / TICK_US + 1, "disconnected after %u transfers", ticks);
+  SIM_CHECK(sim.conns[0].state.player_count == 2, "the master has %u players", sim.conns[0].state.player_count);
+
+  // The master stops: console 1 only gets timer IRQs.
+  LinkStats stats;
+  lc_reset_stats(&sim.conns[1]);
+  for (ticks = 1; ticks <= settings.timeout * 4; ticks++) {
+    sim.clock += sim.interval * 1024;
+    sim_select(1);
+    lc_on_timer(&sim.conns[1]);
+    lc_get_stats(&sim.conns[1], &stats);
+    if (stats.resets_timeout > 0) {
+      break;
+    }
+  }
+  SIM_CHECK(ticks == settings.timeout_us / TICK_US + 1, "reset after %u timer IRQs", ticks);
+  SIM_CHECK(sim.conns[1].state.player_count == 0, "%u players after the reset", sim.conns[1].state.player_count);
+
+  printf("test_timeouts: %u us\n", settings.timeout_us);
+  return 0;
+}
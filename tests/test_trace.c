@@ -0,0 +1,65 @@
+/*
+test_trace - Checks that LINK_ENABLE_TRACE starts the cascaded clock and that
+the trace ring keeps the newest IRQs, oldest first, with their timestamps and
+the words they saw.
+
+Usage:
+
+  test_trace
+*/
+
+#define LINK_ENABLE_TRACE
+#include "link_sim.h"
+
+#define TICKS 100
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(2, settings, 30);
+  sim_activate();
+  sim_select(1);
+  SIM_CHECK(REG_TM[LINK_CLOCK_TIMER].cnt == (TM_ENABLE | TM_FREQ_SYS), "the clock's low timer isn't running");
+  SIM_CHECK(REG_TM[LINK_CLOCK_TIMER + 1].cnt == (TM_ENABLE | TM_CASCADE), "the clock's high timer isn't cascaded");
+
+  for (u32 tick = 1; tick <= TICKS; tick++) {
+    sim_select(0);
+    lc_send(&sim.conns[0], 1000 + tick);
+    sim_run(1, 1);
+  }
+  sim_select(1);
+  SIM_CHECK(lc_clock_now() == sim.clock, "clock at %u, expected %u", lc_clock_now(), sim.clock);
+
+  LinkTraceEvent events[LINK_TRACE_LEN + 1];
+  u32 count = lc_trace_dump(&sim.conns[1], events, LINK_TRACE_LEN + 1);
+  SIM_CHECK(count == LINK_TRACE_LEN, "%u events", count);
+  const LinkTraceEvent *last = &events[count - 1];
+  SIM_CHECK(last->type == LINK_EVENT_VBLANK && last->time == sim.clock, "the last event isn't the last VBlank");
+  u32 serials = 0;
+  for (u32 i = 0; i < count; i++) {
+    SIM_CHECK(i == 0 || events[i].time >= events[i - 1].time, "event %u went back in time", i);
+    SIM_CHECK(events[i].time > 0xFFFF, "event %u: %u, the high timer was ignored", i, events[i].time);
+    if (events[i].type == LINK_EVENT_SERIAL) {
+      SIM_CHECK(events[i].time % (settings.interval * 1024) == 0, "a serial IRQ at %u", events[i].time);
+      // Tick `t` queues 1000 + t, and its timer IRQ sends it right away.
+      u32 tick = events[i].time / (settings.interval * 1024);
+      SIM_CHECK(events[i].data[0] == 1000 + tick, "transfer %u carried 0x%04x", tick, events[i].data[0]);
+      SIM_CHECK(events[i].data[1] == LINK_NO_DATA, "the slave sent 0x%04x", events[i].data[1]);
+      serials++;
+    }
+  }
+  SIM_CHECK(serials == LINK_TRACE_LEN / 3, "%u serial events", serials);
+
+  SIM_CHECK(lc_trace_dump(&sim.conns[1], events, 5) == 5 && events[4].time == last->time, "not the newest 5");
+  lc_trace_clear(&sim.conns[1]);
+  SIM_CHECK(lc_trace_dump(&sim.conns[1], events, LINK_TRACE_LEN) == 0, "events after lc_trace_clear");
+
+  printf("test_trace: %u events\n", count);
+  return 0;
+}
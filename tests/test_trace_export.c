@@ -0,0 +1,94 @@
+/*
+test_trace_export - Saves trace captures from a master and a slave whose clock
+started later, runs them through tools/link_trace_export and checks that the
+slave's serial IRQs land on the master's in the output, and that a gap in the
+transfers shows up as a stall.
+
+Usage:
+
+  test_trace_export
+*/
+
+#define LINK_ENABLE_TRACE
+#include "link_sim.h"
+
+#include <string.h>
+
+#define TICKS 40
+#define GAP_TICKS 20
+#define SLAVE_LATE 123456   // Clock ticks the slave's clock is behind
+#define MAX_SERIALS LINK_TRACE_LEN
+
+static u8 capture[sizeof(LinkTraceHeader) + LINK_TRACE_LEN * sizeof(LinkTraceEvent)];
+
+static void save(u32 console, const char *path) {
+  u32 size = lc_trace_save(&sim.conns[console], (vu8 *)capture, sizeof(capture));
+  FILE *file = fopen(path, "wb");
+  SIM_CHECK(file && fwrite(capture, 1, size, file) == size, "can't write %s", path);
+  fclose(file);
+}
+
+static double field(const char *line, const char *name) {
+  const char *value = strstr(line, name);
+  return value ? atof(value + strlen(name)) : -1;
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .buffer_len = 32,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(2, settings, 31);
+  sim_activate();
+  for (u32 tick = 1; tick <= TICKS; tick++) {
+    for (u32 i = 0; i < 2; i++) {
+      sim_select(i);
+      lc_send(&sim.conns[i], (i + 1) * 1000 + tick);
+    }
+    if (tick == TICKS - 10) {
+      sim.clock += GAP_TICKS * settings.interval * 1024;
+    }
+    sim_run(1, 4);
+  }
+  for (u32 i = 0; i < LINK_TRACE_LEN; i++) {
+    sim.conns[1].trace[i].time -= SLAVE_LATE;
+  }
+  save(0, "test_trace_export.master.sav");
+  save(1, "test_trace_export.slave.sav");
+
+  FILE *json = popen("../tools/link_trace_export test_trace_export.master.sav test_trace_export.slave.sav", "r");
+  SIM_CHECK(json, "can't run link_trace_export");
+  double serials[2][MAX_SERIALS];
+  u32 counts[2] = {}, stalls = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), json)) {
+    int pid = (int)field(line, "\"pid\": ");
+    if (strstr(line, "\"name\": \"serial\"") && counts[pid] < MAX_SERIALS) {
+      serials[pid][counts[pid]++] = field(line, "\"ts\": ");
+    } else if (strstr(line, "\"name\": \"stall\"")) {
+      double gap = (GAP_TICKS + 1) * settings.interval * 1024 * 1000000.0 / LINK_CLOCK_FREQUENCY;
+      SIM_CHECK(field(line, "\"dur\": ") > gap - 1 && field(line, "\"dur\": ") < gap + 1, "a stall of %.3fus",
+                field(line, "\"dur\": "));
+      stalls++;
+    }
+  }
+  SIM_CHECK(pclose(json) == 0, "link_trace_export failed");
+  remove("test_trace_export.master.sav");
+  remove("test_trace_export.slave.sav");
+
+  SIM_CHECK(counts[0] > 0 && counts[0] == counts[1], "%u and %u serial events", counts[0], counts[1]);
+  for (u32 i = 0; i < counts[1]; i++) {
+    // Both captures end with the same events, so the last ones are the same transfers.
+    double master = serials[0][counts[0] - counts[1] + i];
+    SIM_CHECK(serials[1][i] > master - 0.01 && serials[1][i] < master + 0.01, "slave serial %u at %.3fus, master at %.3fus",
+              i, serials[1][i], master);
+  }
+  SIM_CHECK(stalls == 2, "%u stalls", stalls);
+
+  printf("test_trace_export: %u serial events aligned\n", counts[1]);
+  return 0;
+}
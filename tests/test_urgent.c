@@ -0,0 +1,97 @@
+/*
+test_urgent - LINK_ENABLE_URGENT messages (escaped ones too) overtake a full
+outgoing queue, and go through random transfer errors without LINK_ENABLE_RELIABLE:
+they can get lost, or arrive twice when only the sender saw the error, but every
+one that arrives is intact and in order, and nothing arrives that wasn't sent.
+
+Usage:
+
+  test_urgent
+*/
+
+#define LINK_ENABLE_URGENT
+#define LINK_ENABLE_STATS
+#include "link_sim.h"
+
+#define CONSOLES 2
+#define TICKS 300
+#define URGENT_EVERY 7
+
+// Normal messages are below 0x8000, urgent ones above.
+static u16 normal(u32 i) {
+  return 1 + i % 0x7FFF;
+}
+static u16 urgent(u32 i) {
+  return 0x8000 + i;
+}
+
+int main(void) {
+  LinkConnectionSettings settings = {
+    .baud_rate = BAUD_RATE_1,
+    .timeout = 3,
+    .remote_timeout = 5,
+    .soft_resets = 8,
+    .buffer_len = 16,
+    .interval = 50,
+    .send_timer_id = 3,
+  };
+  sim_init(CONSOLES, settings, 44);
+  sim_activate();
+  sim_run(20, 4);
+
+  // A full queue doesn't hold an urgent message back.
+  sim_select(0);
+  u32 sent = 0;
+  while (lc_send(&sim.conns[0], normal(sent))) {
+    sent++;
+  }
+  const u16 first[] = {urgent(0), 0xFE25, 0xFFFE};
+  for (u32 i = 0; i < 3; i++) {
+    SIM_CHECK(lc_send_urgent(&sim.conns[0], first[i]), "urgent message rejected");
+  }
+  sim_run(8, 4);
+  sim_select(1);
+  for (u32 i = 0; i < 3; i++) {
+    u16 value = lc_read_message(&sim.conns[1], 0);
+    SIM_CHECK(value == first[i], "got 0x%04x, expected the urgent 0x%04x", value, first[i]);
+  }
+  u32 received = 0, received_urgent = 0, sent_urgent = 1;
+
+  // Random errors (and the messages they take) don't corrupt the others.
+  sim.error_rate = 3000;
+  for (u32 tick = 0; tick < TICKS; tick++) {
+    sim_select(0);
+    if (lc_send(&sim.conns[0], normal(sent))) {
+      sent++;
+    }
+    if (tick % URGENT_EVERY == 0 && lc_send_urgent(&sim.conns[0], urgent(sent_urgent))) {
+      sent_urgent++;
+    }
+    sim_select(1);
+    u16 value;
+    while ((value = lc_read_message(&sim.conns[1], 0)) != LINK_NO_DATA) {
+      if (value < 0x8000) {
+        SIM_CHECK(value > received && value <= normal(sent - 1), "unexpected message 0x%04x after #%u", value,
+                  received);
+        received = value;
+      } else {
+        // The last one again, or a later one.
+        u32 i = value - urgent(0);
+        SIM_CHECK(i >= received_urgent && i < sent_urgent, "unexpected urgent message 0x%04x after #%u", value,
+                  received_urgent);
+        received_urgent = i;
+      }
+    }
+    sim_timer();
+    if (tick % 4 == 0) {
+      sim_vblank();
+    }
+  }
+
+  LinkStats stats;
+  lc_get_stats(&sim.conns[1], &stats);
+  SIM_CHECK(stats.transfer_errors > 0, "no transfer errors");
+  SIM_CHECK(received_urgent > sent_urgent / 2, "up to %u of %u urgent messages arrived", received_urgent, sent_urgent);
+  printf("test_urgent: %u urgent messages through %u transfer errors\n", sent_urgent, stats.transfer_errors);
+  return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef LINK_HOST_TONC_CORE_H
+#define LINK_HOST_TONC_CORE_H
+
+/*
+Minimal stand-ins for the libtonc headers, so `link_connection.h` can be
+compiled on a PC by the tools in this directory. I/O registers are backed
+by the `lc_host_io` array, which the including program must define:
+
+  volatile u16 *lc_host_io;
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned char u8;
+typedef unsigned short u16;
+typedef unsigned int u32;
+typedef signed char s8;
+typedef signed short s16;
+typedef signed int s32;
+typedef volatile u8 vu8;
+typedef volatile u16 vu16;
+typedef volatile u32 vu32;
+
+#define INLINE static inline
+#define IWRAM_CODE
+#define EWRAM_CODE
+#define IWRAM_DATA
+#define EWRAM_DATA
+
+typedef struct TMR_REC {
+  union { u16 start, count; } __attribute__((packed));
+  u16 cnt;
+} __attribute__((aligned(4))) TMR_REC;
+
+extern volatile u16 *lc_host_io;
+
+#endif  // LINK_HOST_TONC_CORE_H
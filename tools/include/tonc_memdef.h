@@ -0,0 +1,22 @@
+#ifndef LINK_HOST_TONC_MEMDEF_H
+#define LINK_HOST_TONC_MEMDEF_H
+
+#define TM_FREQ_SYS 0
+#define TM_FREQ_1 0
+#define TM_FREQ_64 0x0001
+#define TM_FREQ_256 0x0002
+#define TM_FREQ_1024 0x0003
+#define TM_CASCADE 0x0004
+#define TM_IRQ 0x0040
+#define TM_ENABLE 0x0080
+
+#define IRQ_VBLANK 0x0001
+#define IRQ_HBLANK 0x0002
+#define IRQ_VCOUNT 0x0004
+#define IRQ_TIMER0 0x0008
+#define IRQ_TIMER1 0x0010
+#define IRQ_TIMER2 0x0020
+#define IRQ_TIMER3 0x0040
+#define IRQ_SERIAL 0x0080
+
+#endif  // LINK_HOST_TONC_MEMDEF_H
@@ -0,0 +1,19 @@
+#ifndef LINK_HOST_TONC_MEMMAP_H
+#define LINK_HOST_TONC_MEMMAP_H
+
+#include "tonc_core.h"
+
+#define LINK_HOST_IO_SIZE 0x210
+#define LINK_HOST_REG(OFFSET) (lc_host_io[(OFFSET) / 2])
+
+#define REG_VCOUNT LINK_HOST_REG(0x0006)
+#define REG_TM ((volatile TMR_REC *)&lc_host_io[0x0100 / 2])
+#define REG_SIOMULTI (&lc_host_io[0x0120 / 2])
+#define REG_SIOCNT LINK_HOST_REG(0x0128)
+#define REG_SIOMLT_SEND LINK_HOST_REG(0x012A)
+#define REG_RCNT LINK_HOST_REG(0x0134)
+#define REG_IE LINK_HOST_REG(0x0200)
+#define REG_IF LINK_HOST_REG(0x0202)
+#define REG_IME LINK_HOST_REG(0x0208)
+
+#endif  // LINK_HOST_TONC_MEMMAP_H
@@ -0,0 +1,442 @@
+/*
+link_replay - Feeds a session recorded with `lc_record_start` back through the library.
+
+Usage:
+
+  link_replay [-q] recording.sav > replay.txt
+
+The recording is replayed on the PC: every IRQ is delivered with the same
+REG_SIOCNT/REG_SIOMULTI values and clock time it had on the console, and every
+recorded call (`lc_send`, `lc_read_message`, packets, bytes, channels...) is
+repeated at the same point between IRQs. Rollback sessions and callbacks are
+attached without a game behind them: only what reaches the link is replayed.
+The output lists what the library sent and returned at each step, followed by
+a summary. It is deterministic, so two replays (e.g. before and after a change
+to the header) can be compared with `diff`. `-q` prints only the summary.
+
+The recording must come from a build with the same LINK_ENABLE_* options as
+this tool. LINK_ENABLE_RELIABLE recordings need a replayer built with:
+
+  make -C tools REPLAY_FLAGS=-DLINK_ENABLE_RELIABLE
+
+For an exact replay, start recording before `lc_activate`.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef LINK_ENABLE_RECORD
+#define LINK_ENABLE_RECORD
+#endif
+#ifndef LINK_ENABLE_STATS
+#define LINK_ENABLE_STATS
+#endif
+#include "tonc_core.h"
+#include "../link_connection.h"
+
+volatile u16 lc_host_io_mem[LINK_HOST_IO_SIZE / 2];
+volatile u16 *lc_host_io = lc_host_io_mem;
+
+static const char *EVENT_NAMES[] = {"serial", "timer", "vblank"};
+
+typedef struct Reader {
+  u8 *data;
+  u32 len;
+  u32 pos;
+} Reader;
+
+static bool read_u8(Reader *reader, u8 *out) {
+  if (reader->pos >= reader->len) {
+    return false;
+  }
+  *out = reader->data[reader->pos++];
+  return true;
+}
+
+static bool read_u16(Reader *reader, u16 *out) {
+  u8 low, high;
+  if (!read_u8(reader, &low) || !read_u8(reader, &high)) {
+    return false;
+  }
+  *out = low | (high << 8);
+  return true;
+}
+
+static bool read_varint(Reader *reader, u32 *out) {
+  u32 value = 0;
+  for (u32 shift = 0; shift < 35; shift += 7) {
+    u8 byte;
+    if (!read_u8(reader, &byte)) {
+      return false;
+    }
+    value |= (u32)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *out = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void ignore_message(void *context, u8 player_id, u16 data) {
+  (void)context;
+  (void)player_id;
+  (void)data;
+}
+
+// Repeats a call other than `lc_send`/`lc_read_message`. Returns false if the record is cut short.
+static bool replay_call(Reader *reader, LinkConnection *conn, u8 player_id, double ts, bool quiet) {
+  u8 call;
+  u32 a, b;
+  if (!read_u8(reader, &call) || !read_varint(reader, &a) || !read_varint(reader, &b)) {
+    return false;
+  }
+  u32 payload_len = call == LINK_RECORD_CALL_PACKET ? a * 2 : call == LINK_RECORD_CALL_WRITE ? a : 0;
+  if (reader->len - reader->pos < payload_len) {
+    return false;
+  }
+  u8 *payload = reader->data + reader->pos;
+  reader->pos += payload_len;
+  if (!quiet) {
+    printf("%12.3f ", ts);
+  }
+
+  switch (call) {
+    case LINK_RECORD_CALL_URGENT: {
+      bool queued = lc_send_urgent(conn, a);
+      if (!quiet) {
+        printf("send urgent 0x%04x%s\n", a, queued ? "" : " (rejected)");
+      }
+      break;
+    }
+    case LINK_RECORD_CALL_PACKET: {
+      u16 *words = calloc(a + 1, sizeof(u16));
+      for (u32 i = 0; i < a; i++) {
+        words[i] = payload[i * 2] | (payload[i * 2 + 1] << 8);
+      }
+      bool queued = lc_send_packet(conn, words, a);
+      free(words);
+      if (!quiet) {
+        printf("send packet of %u words%s\n", a, queued ? "" : " (rejected)");
+      }
+      break;
+    }
+    case LINK_RECORD_CALL_WRITE: {
+      u32 written = lc_write(conn, payload, a);
+      if (!quiet) {
+        printf("write %u bytes -> %u\n", a, written);
+      }
+      break;
+    }
+    case LINK_RECORD_CALL_READ: {
+      u8 *buf = malloc(a + 1);
+      u32 read = lc_read(conn, player_id, buf, a);
+      if (!quiet) {
+        printf("read %u bytes P%d ->", a, player_id);
+        for (u32 i = 0; i < read; i++) {
+          printf(" %02x", buf[i]);
+        }
+        printf("\n");
+      }
+      free(buf);
+      break;
+    }
+    case LINK_RECORD_CALL_CHANNEL_SEND: {
+      bool queued = lc_channel_send(conn, a, b);
+      if (!quiet) {
+        printf("send channel %u 0x%04x%s\n", a, b, queued ? "" : " (rejected)");
+      }
+      break;
+    }
+    case LINK_RECORD_CALL_CHANNEL_READ: {
+      u16 value = lc_channel_read(conn, a, player_id);
+      if (!quiet) {
+        printf("read channel %u P%d -> 0x%04x\n", a, player_id, value);
+      }
+      break;
+    }
+    case LINK_RECORD_CALL_CHANNEL_WEIGHT:
+      lc_channel_weight(conn, a, b);
+      if (!quiet) {
+        printf("channel %u weight %u\n", a, b);
+      }
+      break;
+    case LINK_RECORD_CALL_CHECKSUM_START:
+      lc_checksum_start(conn, a, NULL, NULL);
+      if (!quiet) {
+        printf("checksum every %u frames\n", a);
+      }
+      break;
+    case LINK_RECORD_CALL_CHECKSUM:
+      lc_checksum_submit(conn, a, b);
+      if (!quiet) {
+        printf("checksum frame %u 0x%04x\n", a, b);
+      }
+      break;
+    case LINK_RECORD_CALL_PING: {
+      bool queued = lc_ping(conn);
+      if (!quiet) {
+        printf("ping%s\n", queued ? "" : " (rejected)");
+      }
+      break;
+    }
+#ifdef LINK_ENABLE_ROLLBACK
+    case LINK_RECORD_CALL_ROLLBACK: {
+      static LinkRollback rollback;
+      if (a) {
+        lc_rollback_init(&rollback, conn, NULL, NULL);
+      } else if (conn->rollback) {
+        lc_rollback_stop(&rollback);
+      }
+      if (!quiet) {
+        printf("rollback %s\n", a ? "attached" : "detached");
+      }
+      break;
+    }
+    case LINK_RECORD_CALL_INPUT: {
+      bool queued = lc_rollback_send(conn, a);
+      if (!quiet) {
+        printf("send input 0x%04x%s\n", a, queued ? "" : " (rejected)");
+      }
+      break;
+    }
+#endif
+    case LINK_RECORD_CALL_CALLBACKS:
+      lc_set_callbacks(conn, (LinkCallbacks) {.on_message = b ? ignore_message : NULL, .from_irq = a});
+      if (!quiet) {
+        printf("callbacks%s%s\n", a ? " from_irq" : "", b ? " on_message" : "");
+      }
+      break;
+    default:
+      if (!quiet) {
+        printf("unknown call %d\n", call);
+      }
+      return false;
+  }
+  return true;
+}
+
+static void set_clock(u32 time) {
+  REG_TM[LINK_CLOCK_TIMER].count = time & 0xFFFF;
+  REG_TM[LINK_CLOCK_TIMER + 1].count = time >> 16;
+}
+
+static void print_resets(LinkStats *before, LinkStats *after, bool quiet) {
+  if (quiet) {
+    return;
+  }
+  if (after->resets_timeout != before->resets_timeout) {
+    printf("  reset (timeout)\n");
+  }
+  if (after->resets_error != before->resets_error) {
+    printf("  reset (error)\n");
+  }
+  if (after->resets_soft != before->resets_soft) {
+    printf("  soft reset\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  bool quiet = false;
+  int arg = 1;
+  if (arg < argc && strcmp(argv[arg], "-q") == 0) {
+    quiet = true;
+    arg++;
+  }
+  if (arg + 1 != argc) {
+    fprintf(stderr, "usage: %s [-q] recording.sav > replay.txt\n", argv[0]);
+    return 1;
+  }
+
+  const char *path = argv[arg];
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return 1;
+  }
+  LinkRecordHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != LINK_RECORD_MAGIC) {
+    fprintf(stderr, "%s: not a link recording\n", path);
+    fclose(file);
+    return 1;
+  }
+  if (header.version != LINK_RECORD_VERSION) {
+    fprintf(stderr, "%s: unsupported recording version %d\n", path, header.version);
+    fclose(file);
+    return 1;
+  }
+  if (header.features != lc_features()) {
+    fprintf(stderr, "%s: recorded with features 0x%x, but this replayer has 0x%x (see REPLAY_FLAGS)\n",
+            path, header.features, lc_features());
+    fclose(file);
+    return 1;
+  }
+  // Without `lc_record_stop` the length is unknown: replay until the data runs out.
+  bool stopped = header.length != 0;
+  long offset = ftell(file);
+  fseek(file, 0, SEEK_END);
+  u32 available = ftell(file) - offset;
+  fseek(file, offset, SEEK_SET);
+  if (!stopped) {
+    fprintf(stderr, "%s: recording wasn't stopped, replaying all %u bytes\n", path, available);
+  } else if (available < header.length) {
+    fprintf(stderr, "%s: truncated recording (%u of %u bytes)\n", path, available, header.length);
+  }
+
+  Reader reader = {.len = stopped && header.length < available ? header.length : available};
+  reader.data = malloc(reader.len + 1);
+  reader.len = fread(reader.data, 1, reader.len, file);
+  fclose(file);
+
+  LinkConnectionSettings settings = {
+    .baud_rate = header.baud_rate,
+    .timeout = header.timeout,
+    .remote_timeout = header.remote_timeout,
+    .soft_resets = header.soft_resets,
+    .buffer_len = header.buffer_len,
+    .interval = header.interval,
+    .send_timer_id = header.send_timer_id,
+    .delta_refresh = header.delta_refresh,
+    .timeout_us = header.timeout_us,
+    .remote_timeout_us = header.remote_timeout_us,
+  };
+  LinkConnection conn = lc_init(settings);
+  lc_activate(&conn);
+
+  u32 time = 0;
+  u16 siocnt = 0;
+  u16 data[LINK_MAX_PLAYERS] = {};
+  u32 counts[4] = {}, cycles[3] = {}, max_cycles[3] = {};
+  u32 reads = 0, sends = 0, rejected = 0, calls = 0;
+  unsigned long long elapsed = 0;
+  if (!quiet) {
+    printf("# %s: baud %d, timeout %u, remote_timeout %u, soft_resets %u, buffer_len %u, interval %u, "
+           "delta_refresh %u, timeout_us %u, remote_timeout_us %u\n",
+           path, header.baud_rate, header.timeout, header.remote_timeout, header.soft_resets,
+           header.buffer_len, header.interval, header.delta_refresh, header.timeout_us, header.remote_timeout_us);
+  }
+
+  for (;;) {
+    u32 start = reader.pos;
+    u8 head;
+    u32 delta;
+    if (!read_u8(&reader, &head) || !read_varint(&reader, &delta)) {
+      break;
+    }
+    u8 kind = head & 0b11;
+    time += delta;
+    elapsed += delta;
+    set_clock(time);
+    double ts = (double)elapsed * 1000000.0 / header.frequency;
+
+    if (kind == LINK_RECORD_CALL) {
+      u8 player_id = (head >> 4) & 0b11;
+      if (head & (1 << 3)) {
+        if (!replay_call(&reader, &conn, player_id, ts, quiet)) {
+          reader.pos = start;
+          break;
+        }
+        calls++;
+      } else if (head & (1 << 2)) {
+        u16 value = lc_read_message(&conn, player_id);
+        reads++;
+        if (!quiet) {
+          printf("%12.3f read P%d -> 0x%04x\n", ts, player_id, value);
+        }
+      } else {
+        u16 value;
+        if (!read_u16(&reader, &value)) {
+          reader.pos = start;
+          break;
+        }
+        bool queued = lc_send(&conn, value);
+        sends++;
+        rejected += !queued;
+        if (!quiet) {
+          printf("%12.3f send 0x%04x%s\n", ts, value, queued ? "" : " (rejected)");
+        }
+      }
+      continue;
+    }
+
+    u32 irq_cycles;
+    bool ok = read_varint(&reader, &irq_cycles);
+    if (ok && (head & (1 << 3))) {
+      ok = read_u16(&reader, &siocnt);
+    }
+    for (u32 i = 0; ok && i < LINK_MAX_PLAYERS; i++) {
+      if (head & (1 << (4 + i))) {
+        ok = read_u16(&reader, &data[i]);
+      }
+    }
+    if (!ok) {
+      reader.pos = start;
+      break;
+    }
+
+    REG_SIOCNT = siocnt;
+    for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+      REG_SIOMULTI[i] = data[i];
+    }
+    REG_SIOMLT_SEND = LINK_NO_DATA;
+
+    LinkStats before, after;
+    lc_get_stats(&conn, &before);
+    conn.state.is_locked = (head >> 2) & 1;
+    if (kind == LINK_RECORD_SERIAL) {
+      lc_on_serial(&conn);
+    } else if (kind == LINK_RECORD_TIMER) {
+      lc_on_timer(&conn);
+    } else {
+      lc_on_vblank(&conn);
+    }
+    conn.state.is_locked = false;
+    lc_get_stats(&conn, &after);
+
+    counts[kind]++;
+    cycles[kind] += irq_cycles;
+    if (irq_cycles > max_cycles[kind]) {
+      max_cycles[kind] = irq_cycles;
+    }
+    if (!quiet) {
+      printf("%12.3f %-6s", ts, EVENT_NAMES[kind]);
+      if (kind != LINK_RECORD_VBLANK) {
+        printf(" siocnt=0x%04x", siocnt);
+      }
+      if (kind == LINK_RECORD_SERIAL) {
+        printf(" data=[0x%04x 0x%04x 0x%04x 0x%04x]", data[0], data[1], data[2], data[3]);
+      }
+      if (after.words_sent != before.words_sent) {
+        printf(" -> 0x%04x", REG_SIOMLT_SEND);
+      }
+      printf("%s (%u cycles)\n", (head >> 2) & 1 ? " locked" : "", irq_cycles);
+      print_resets(&before, &after, quiet);
+    }
+  }
+
+  if (reader.pos < reader.len && stopped) {
+    fprintf(stderr, "%s: invalid record at byte %u\n", path, (u32)sizeof(header) + reader.pos);
+  }
+
+  LinkStats stats;
+  lc_get_stats(&conn, &stats);
+  printf("# %.3f ms, %u serial / %u timer / %u vblank IRQs, %u sends (%u rejected), %u reads, %u other calls\n",
+         (double)elapsed * 1000.0 / header.frequency, counts[0], counts[1], counts[2], sends, rejected, reads,
+         calls);
+  for (u32 kind = 0; kind < 3; kind++) {
+    if (counts[kind] > 0) {
+      printf("# %s IRQ: %u cycles avg, %u max (recorded)\n", EVENT_NAMES[kind], cycles[kind] / counts[kind],
+             max_cycles[kind]);
+    }
+  }
+  printf("# transfers %u, errors %u, words sent %u, received [%u %u %u %u]\n", stats.transfers,
+         stats.transfer_errors, stats.words_sent, stats.words_received[0], stats.words_received[1],
+         stats.words_received[2], stats.words_received[3]);
+  printf("# resets: %u timeout, %u error, %u soft; %u retransmissions, %u overflows\n", stats.resets_timeout,
+         stats.resets_error, stats.resets_soft, stats.retransmissions, stats.queue_overflows);
+
+  lc_destroy(&conn);
+  free(reader.data);
+  return 0;
+}
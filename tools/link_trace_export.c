@@ -0,0 +1,275 @@
+/*
+link_trace_export - Converts link trace captures to Chrome trace event JSON.
+
+Usage:
+
+  link_trace_export [-s stall_us] master.sav [slave.sav ...] > trace.json
+
+Each input is a capture written by `lc_trace_save` on one console (it can be
+followed by unused save memory). Put the master's capture first: the others are
+aligned to its clock by finding a run of transfers with data (not just 0x0000
+or 0xFFFF) whose REG_SIOMULTI words appear only once in the master's capture. Open the output in chrome://tracing or https://ui.perfetto.dev.
+
+Gaps between serial IRQs longer than `stall_us` (default: 4x the median gap of
+each console) are shown as "stall" slices.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINK_ENABLE_TRACE
+#include "tonc_core.h"
+#include "../link_connection.h"
+
+volatile u16 lc_host_io_mem[LINK_HOST_IO_SIZE / 2];
+volatile u16 *lc_host_io = lc_host_io_mem;
+
+#define MAX_CAPTURES LINK_MAX_PLAYERS
+#define TID_SERIAL 0
+#define TID_TIMER 1
+#define TID_VBLANK 2
+#define TID_RESET 3
+#define ALIGN_RUN 4   // Busy transfers in a row that must match to align two captures
+
+typedef struct Capture {
+  const char *path;
+  LinkTraceEvent *events;
+  double *times;        // Microseconds, on the master's timeline
+  u32 count;
+  u32 frequency;
+} Capture;
+
+static const char *EVENT_NAMES[] = {"serial", "timer", "vblank", "reset"};
+static const char *TRACK_NAMES[] = {"Serial IRQ", "Timer IRQ", "VBlank IRQ", "Resets"};
+
+static bool load_capture(Capture *capture, const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+
+  LinkTraceHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != LINK_TRACE_MAGIC) {
+    fprintf(stderr, "%s: not a link trace capture\n", path);
+    fclose(file);
+    return false;
+  }
+  if (header.version != LINK_TRACE_VERSION || header.event_size != sizeof(LinkTraceEvent)) {
+    fprintf(stderr, "%s: unsupported capture version %d\n", path, header.version);
+    fclose(file);
+    return false;
+  }
+
+  capture->path = path;
+  capture->frequency = header.frequency;
+  capture->events = calloc(header.count + 1, sizeof(LinkTraceEvent));
+  capture->times = calloc(header.count + 1, sizeof(double));
+  capture->count = fread(capture->events, sizeof(LinkTraceEvent), header.count, file);
+  fclose(file);
+  if (capture->count < header.count) {
+    fprintf(stderr, "%s: truncated capture (%u of %u events)\n", path, capture->count, header.count);
+  }
+
+  // Unwrap the 32-bit clock.
+  unsigned long long wraps = 0;
+  for (u32 i = 0; i < capture->count; i++) {
+    if (i > 0 && capture->events[i].time < capture->events[i - 1].time) {
+      wraps += 1ULL << 32;
+    }
+    capture->times[i] = (double)(wraps + capture->events[i].time) * 1000000.0 / capture->frequency;
+  }
+  return true;
+}
+
+static bool same_transfer(LinkTraceEvent *a, LinkTraceEvent *b) {
+  return memcmp(a->data, b->data, sizeof(a->data)) == 0;
+}
+
+// Transfers where nobody sent anything look the same everywhere.
+static bool is_idle(LinkTraceEvent *event) {
+  for (u32 i = 0; i < LINK_MAX_PLAYERS; i++) {
+    if (event->data[i] != LINK_NO_DATA && event->data[i] != LINK_DISCONNECTED) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int next_serial(Capture *capture, int i) {
+  for (i++; i < (int)capture->count; i++) {
+    if (capture->events[i].type == LINK_EVENT_SERIAL) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Indices of the serial events that carried data.
+static u32 busy_serials(Capture *capture, u32 *out) {
+  u32 count = 0;
+  for (u32 i = 0; i < capture->count; i++) {
+    if (capture->events[i].type == LINK_EVENT_SERIAL && !is_idle(&capture->events[i])) {
+      out[count++] = i;
+    }
+  }
+  return count;
+}
+
+static bool same_run(Capture *a, u32 *a_serials, Capture *b, u32 *b_serials) {
+  for (u32 k = 0; k < ALIGN_RUN; k++) {
+    if (!same_transfer(&a->events[a_serials[k]], &b->events[b_serials[k]])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Finds the first run of ALIGN_RUN busy transfers that the slave saw and the master
+ * saw exactly once, and moves the slave's timeline onto the master's.
+ */
+static bool align(Capture *master, Capture *slave) {
+  u32 *master_serials = calloc(master->count + 1, sizeof(u32));
+  u32 *slave_serials = calloc(slave->count + 1, sizeof(u32));
+  u32 master_count = busy_serials(master, master_serials);
+  u32 slave_count = busy_serials(slave, slave_serials);
+  bool aligned = false;
+  for (u32 i = 0; !aligned && i + ALIGN_RUN <= slave_count; i++) {
+    int match = -1;
+    u32 matches = 0;
+    for (u32 j = 0; j + ALIGN_RUN <= master_count && matches < 2; j++) {
+      if (same_run(slave, &slave_serials[i], master, &master_serials[j])) {
+        match = j;
+        matches++;
+      }
+    }
+    if (matches == 1) {
+      double offset = master->times[master_serials[match]] - slave->times[slave_serials[i]];
+      for (u32 k = 0; k < slave->count; k++) {
+        slave->times[k] += offset;
+      }
+      aligned = true;
+    }
+  }
+  free(master_serials);
+  free(slave_serials);
+  return aligned;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double median_serial_gap(Capture *capture) {
+  double *gaps = calloc(capture->count + 1, sizeof(double));
+  u32 count = 0;
+  int previous = -1;
+  for (int i = next_serial(capture, -1); i >= 0; i = next_serial(capture, i)) {
+    if (previous >= 0) {
+      gaps[count++] = capture->times[i] - capture->times[previous];
+    }
+    previous = i;
+  }
+  double median = 0;
+  if (count > 0) {
+    qsort(gaps, count, sizeof(double), compare_doubles);
+    median = gaps[count / 2];
+  }
+  free(gaps);
+  return median;
+}
+
+static void print_separator(bool *first) {
+  printf(*first ? "\n    " : ",\n    ");
+  *first = false;
+}
+
+static void export_capture(Capture *capture, int pid, double stall_us, bool *first) {
+  u16 siocnt = capture->count > 0 ? capture->events[0].siocnt : 0;
+  print_separator(first);
+  printf("{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"P%d %s (%s)\"}}",
+         pid, (siocnt >> LINK_BITS_PLAYER_ID) & 0b11,
+         (siocnt >> LINK_BIT_SLAVE) & 1 ? "slave" : "master", capture->path);
+  for (int tid = 0; tid <= TID_RESET; tid++) {
+    print_separator(first);
+    printf("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+           pid, tid, TRACK_NAMES[tid]);
+  }
+
+  if (stall_us <= 0) {
+    stall_us = median_serial_gap(capture) * 4;
+  }
+
+  int previous_serial = -1;
+  for (u32 i = 0; i < capture->count; i++) {
+    LinkTraceEvent *event = &capture->events[i];
+    double ts = capture->times[i];
+    if (event->type > LINK_EVENT_RESET) {
+      continue;
+    }
+
+    print_separator(first);
+    printf("{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"%s\", \"ts\": %.3f, \"pid\": %d, \"tid\": %d, "
+           "\"args\": {\"siocnt\": \"0x%04x\", \"data\": [\"0x%04x\", \"0x%04x\", \"0x%04x\", \"0x%04x\"]}}",
+           EVENT_NAMES[event->type], event->type == LINK_EVENT_RESET ? "p" : "t", ts, pid, event->type,
+           event->siocnt, event->data[0], event->data[1], event->data[2], event->data[3]);
+
+    print_separator(first);
+    printf("{\"name\": \"queues\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": %d, "
+           "\"args\": {\"outgoing\": %d, \"incoming0\": %d, \"incoming1\": %d, \"incoming2\": %d, \"incoming3\": %d}}",
+           ts, pid, event->outgoing_len, event->incoming_len[0], event->incoming_len[1],
+           event->incoming_len[2], event->incoming_len[3]);
+
+    if (event->type == LINK_EVENT_SERIAL) {
+      if (previous_serial >= 0 && stall_us > 0 && ts - capture->times[previous_serial] > stall_us) {
+        print_separator(first);
+        printf("{\"name\": \"stall\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %d}",
+               capture->times[previous_serial], ts - capture->times[previous_serial], pid, TID_SERIAL);
+      }
+      previous_serial = i;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  double stall_us = 0;
+  int arg = 1;
+  if (arg + 1 < argc && strcmp(argv[arg], "-s") == 0) {
+    stall_us = atof(argv[arg + 1]);
+    arg += 2;
+  }
+  if (arg >= argc || argc - arg > MAX_CAPTURES) {
+    fprintf(stderr, "usage: %s [-s stall_us] master.sav [slave.sav ...] > trace.json\n", argv[0]);
+    return 1;
+  }
+
+  Capture captures[MAX_CAPTURES] = {};
+  int count = 0;
+  for (; arg < argc; arg++) {
+    if (!load_capture(&captures[count++], argv[arg])) {
+      return 1;
+    }
+  }
+  for (int i = 1; i < count; i++) {
+    if (!align(&captures[0], &captures[i])) {
+      fprintf(stderr, "%s: no transfers in common with %s, timeline not aligned\n",
+              captures[i].path, captures[0].path);
+    }
+  }
+
+  bool first = true;
+  printf("{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [");
+  for (int i = 0; i < count; i++) {
+    export_capture(&captures[i], i, stall_us, &first);
+  }
+  printf("\n  ]\n}\n");
+
+  for (int i = 0; i < count; i++) {
+    free(captures[i].events);
+    free(captures[i].times);
+  }
+  return 0;
+}